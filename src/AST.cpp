@@ -2,59 +2,32 @@
 #include "AST.h"
 #include "Symbol.h"
 #include "utils.h"
+#include "Trace.h"
 using namespace std;
 
 KoopaIR ki;             // Koopa 中间代码
+Arena ast_arena;         // AST 节点和标识符文本
 SStack st;    // 符号表
 BlockController bc;     // 通过一个bool值管理代码块的活动状态（遇到break，continue, return）
                         // set设为1，finish设为0，alive检查值
 WhileStack wst;         // 用栈管理循环，记录入口、循环体和结束的标签
                         // 用于break和continue
 
-class ScopeHelper {
-private:
-    static int depth;  // 静态变量，用于记录当前嵌套层数
-    std::string type;
-    std::string name;
-
-    // 辅助函数，用于生成当前层次的缩进
-    std::string getIndent() const {
-        return std::string(depth * 2, ' ');  // 每层缩进两个空格
-    }
-
-public:
-    ScopeHelper(const std::string& type, const std::string& name = "") : type(type), name(name) {
-        std::cout << getIndent();  // 输出当前缩进
-        std::cout << type;  // 输出类型名
-        if (!name.empty()) {
-            std::cout << " (" << name << ")";  // 如果变量名不为空，则输出变量名
-        }
-        std::cout << "{" << std::endl;
-        depth++;  // 进入新的层级
-    }
-    ~ScopeHelper() {
-        depth--;  // 退出当前层级
-        std::cout << getIndent() << "}" << std::endl;
-    }
-};
-
-// 初始化静态成员变量
-int ScopeHelper::depth = 0;
-
 void CompUnitAST::Dump()const {
-    ScopeHelper scope("CompUnitAST");
+    TRACE_SCOPE("CompUnitAST");
     st.alloc(); // 全局作用域
     this->DumpGlobalVar();  // 处理全局变量  
     // 库函数声明
-    ki.declLibFunc();
-    st.insertFUNC("getint", SysYType::SYSY_FUNC_INT);
-    st.insertFUNC("getch", SysYType::SYSY_FUNC_INT);
-    st.insertFUNC("getarray", SysYType::SYSY_FUNC_INT);
-    st.insertFUNC("putint", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("putch", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("putarray", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("starttime", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("stoptime", SysYType::SYSY_FUNC_VOID);
+    IRType *i32 = IRType::getInt32(), *unit = IRType::getUnit();
+    IRType *ptr = IRType::getPointer(i32);
+    st.insertFUNC(idents.intern("getint"), SysYType::SYSY_FUNC_INT, ki.declare("@getint", {}, i32));
+    st.insertFUNC(idents.intern("getch"), SysYType::SYSY_FUNC_INT, ki.declare("@getch", {}, i32));
+    st.insertFUNC(idents.intern("getarray"), SysYType::SYSY_FUNC_INT, ki.declare("@getarray", {ptr}, i32));
+    st.insertFUNC(idents.intern("putint"), SysYType::SYSY_FUNC_VOID, ki.declare("@putint", {i32}, unit));
+    st.insertFUNC(idents.intern("putch"), SysYType::SYSY_FUNC_VOID, ki.declare("@putch", {i32}, unit));
+    st.insertFUNC(idents.intern("putarray"), SysYType::SYSY_FUNC_VOID, ki.declare("@putarray", {i32, ptr}, unit));
+    st.insertFUNC(idents.intern("starttime"), SysYType::SYSY_FUNC_VOID, ki.declare("@starttime", {}, unit));
+    st.insertFUNC(idents.intern("stoptime"), SysYType::SYSY_FUNC_VOID, ki.declare("@stoptime", {}, unit));
 
     int n = func_defs.size();
     for(int i = 0; i < n; ++i)
@@ -75,57 +48,45 @@ void CompUnitAST::DumpGlobalVar() const{
            }
         }
     }
-    ki.append("\n");
 }
 
 void FuncDefAST::Dump() const {
-    ScopeHelper scope("FuncDefAST", ident);
+    TRACE_SCOPE("FuncDefAST", idents.str(ident));
     st.resetNameTable();
-    
-    // 函数名加到符号表
-    st.insertFUNC(ident, btype->tag == BTypeAST::INT ? SysYType::SYSY_FUNC_INT : SysYType::SYSY_FUNC_VOID);
 
     // fun @main(): i32 {
-    ki.append("fun " + st.getName(ident) + "(");
+    vector<IRType *> param_types;
+    if(func_params != nullptr){
+        for(auto &fp : func_params->func_f_params)
+            param_types.push_back(fp->Dump());
+    }
+    IRFunction *func = ki.function("@" + string(idents.str(ident)), param_types, btype->Dump());
+
+    // 函数名加到符号表
+    st.insertFUNC(ident, btype->tag == BTypeAST::INT ? SysYType::SYSY_FUNC_INT : SysYType::SYSY_FUNC_VOID, func);
 
     // 分配函数内层符号表
     st.alloc();
-    vector<string> var_names;   // KoopaIR参数列表的名字
-    
-    // 从符号表中获取KoopaIR变量名，并保存到var_names中
+
+    // 从符号表中获取KoopaIR参数的名字
     if(func_params != nullptr){
         auto &fps = func_params->func_f_params;
         int n = fps.size();
-        // 在大表中给出ident，查找它的name，并将其保存
-        var_names.push_back(st.getVarName(fps[0]->ident));
-        ki.append(var_names.back() + ": ");
-        ki.append(fps[0]->Dump());
-        for(int i = 1; i < n; ++i){
-            ki.append(", ");
-            var_names.push_back(st.getVarName(fps[i]->ident));
-            ki.append(var_names.back() + ": ");
-            ki.append(fps[i]->Dump());
-        }
+        for(int i = 0; i < n; ++i)
+            func->params[i]->name = st.getVarName(idents.str(fps[i]->ident));
     }
-    ki.append(")");
-    btype->Dump();  // 打印函数类型名 ([: i32])
-    ki.append(" {\n");
 
     // 进入Block
     bc.set();
-    ki.label("%entry");
+    ki.label(ki.block("%entry"));
 
     // 把参数加载到变量中
     if(func_params != nullptr){
         int i = 0;
         for(auto &fp : func_params->func_f_params){
-            string var = var_names[i++];
-
-            st.insertINT(fp->ident);
-            string name = st.getName(fp->ident);    // 在小符号表中新开一个name，进行一次store操作
-
-            ki.alloc(name);
-            ki.store(var, name);
+            IRValue *var = ki.alloc();
+            st.insertINT(fp->ident, var);  // 在小符号表中新开一个name，进行一次store操作
+            ki.store(func->params[i++], var);
         }
     }
 
@@ -138,20 +99,20 @@ void FuncDefAST::Dump() const {
     // 特判空块
     if(bc.alive()){
         if(btype->tag == BTypeAST::INT)
-            ki.ret("0");
+            ki.ret(ki.integer(0));
         else
-            ki.ret("");
+            ki.ret(nullptr);
     }
-    ki.append("}\n\n");
+    st.quit();
 }
 
-string FuncFParamAST::Dump() const{
-    ScopeHelper scope("FuncFParamAST", ident);
-    return "i32";
+IRType *FuncFParamAST::Dump() const{
+    TRACE_SCOPE("FuncFParamAST", idents.str(ident));
+    return IRType::getInt32();
 }
 
 void BlockAST::Dump(bool new_symbol_tb) const {
-    ScopeHelper scope("BlockAST");
+    TRACE_SCOPE("BlockAST");
     // into this Block
     if(new_symbol_tb)
         st.alloc();
@@ -167,7 +128,7 @@ void BlockAST::Dump(bool new_symbol_tb) const {
 }
 
 void BlockItemAST::Dump() const{
-    ScopeHelper scope("BlockItemAST", tag == DECL ? "DECL" : "STMT");
+    TRACE_SCOPE("BlockItemAST", tag == DECL ? "DECL" : "STMT");
     if(!bc.alive()) return;
     if(tag == DECL){
         decl->Dump();
@@ -177,7 +138,7 @@ void BlockItemAST::Dump() const{
 }
 
 void DeclAST::Dump() const{
-    ScopeHelper scope("BlockItemAST", tag == CONST_DECL ? "CONST_DECL" : "VAR_DECL");
+    TRACE_SCOPE("BlockItemAST", tag == CONST_DECL ? "CONST_DECL" : "VAR_DECL");
     if(tag == VAR_DECL)
         var_decl->Dump();
     else
@@ -185,33 +146,32 @@ void DeclAST::Dump() const{
 }
 
 void StmtAST::Dump() const {
-    ScopeHelper scope("StmtAST", [&]() -> const std::string& {
-        static const std::string tagNames[] = {
-            "RETURN", "ASSIGN", "BLOCK", "EXP", "WHILE", "BREAK", "CONTINUE", "IF"
-        };
-        return tagNames[tag];
-    }());
+    [[maybe_unused]] static const char *tag_names[] = {
+        "RETURN", "ASSIGN", "BLOCK", "EXP", "WHILE", "BREAK", "CONTINUE", "IF"
+    };
+    TRACE_SCOPE("StmtAST", tag_names[tag]);
     if(!bc.alive()) return;
     if(tag == RETURN){
         if(exp){
-            string ret_name = exp->Dump();
-            ki.ret(ret_name);
+            IRValue *ret_value = exp->Dump();
+            ki.ret(ret_value);
         } else{
-            ki.ret("");
+            ki.ret(nullptr);
         }
         bc.finish();                 // 当前IR的block设为不活跃
     } else if(tag == ASSIGN){
-        string val = exp->Dump();
-        string to = lval->Dump(true);
+        IRValue *val = exp->Dump();
+        IRValue *to = lval->Dump(true);
         ki.store(val, to);
     } else if(tag == BLOCK){
         block->Dump();
     } else if(tag == EXP){
-        exp->Dump();
+        if(exp)
+            exp->Dump();
     } else if(tag == WHILE){
-        string while_entry = st.getLabelName("while_entry");
-        string while_body = st.getLabelName("while_body");
-        string while_end = st.getLabelName("while_end");
+        IRBasicBlock *while_entry = ki.block(st.getLabelName("while_entry"));
+        IRBasicBlock *while_body = ki.block(st.getLabelName("while_body"));
+        IRBasicBlock *while_end = ki.block(st.getLabelName("while_end"));
         
         wst.append(while_entry, while_body, while_end);
 
@@ -219,8 +179,7 @@ void StmtAST::Dump() const {
 
         bc.set();
         ki.label(while_entry);      // WHILE 的中间代码
-        string cond = exp->Dump();
-        ki.br(cond, while_body, while_end);
+        exp->DumpCond(while_body, while_end);
 
         bc.set();
         ki.label(while_body);       // DO 的中间代码
@@ -232,17 +191,16 @@ void StmtAST::Dump() const {
         ki.label(while_end);        // ENDWHILE 的中间代码
         wst.quit();                 // 该while处理已结束，退栈
     } else if(tag == BREAK){
-        ki.jump(wst.getEndName());  // 跳转到while_end
+        ki.jump(wst.getEnd());  // 跳转到while_end
         bc.finish();                // 当前IR的block设为不活跃
     } else if(tag == CONTINUE){
-        ki.jump(wst.getEntryName());// 跳转到while_entry
+        ki.jump(wst.getEntry());// 跳转到while_entry
         bc.finish();                // 当前IR的block设为不活跃
     } else if(tag == IF){
-        string s = exp->Dump();
-        string t = st.getLabelName("then");
-        string e = st.getLabelName("else");
-        string j = st.getLabelName("end");
-        ki.br(s, t, else_stmt == nullptr ? j : e);
+        IRBasicBlock *t = ki.block(st.getLabelName("then"));
+        IRBasicBlock *e = ki.block(st.getLabelName("else"));
+        IRBasicBlock *j = ki.block(st.getLabelName("end"));
+        exp->DumpCond(t, else_stmt == nullptr ? j : e);
 
         // if
         bc.set();
@@ -268,7 +226,7 @@ void StmtAST::Dump() const {
 }
 
 void ConstDeclAST::Dump() const{
-    ScopeHelper scope("ConstDeclAST");
+    TRACE_SCOPE("ConstDeclAST");
     int n = const_defs.size();
     for(int i = 0; i < n; ++i){
         const_defs[i]->Dump();
@@ -276,48 +234,48 @@ void ConstDeclAST::Dump() const{
 }
 
 void VarDeclAST::Dump() const {
-    ScopeHelper scope("VarDeclAST");
+    TRACE_SCOPE("VarDeclAST");
     int n = var_defs.size();
     for(int i = 0; i < n; ++i){
         var_defs[i]->Dump();
     }
 }
 
-void BTypeAST::Dump() const{
-    ScopeHelper scope("BTypeAST", "i32");
+IRType *BTypeAST::Dump() const{
+    TRACE_SCOPE("BTypeAST", "i32");
     if(tag == BTypeAST::INT){
-        ki.append(": i32");
+        return IRType::getInt32();
     }
+    return IRType::getUnit();
 }
 
 void ConstDefAST::Dump(bool is_global) const{
-    ScopeHelper scope("ConstDefAST", ident);
+    TRACE_SCOPE("ConstDefAST", idents.str(ident));
     int v = const_init_val->getValue();
     st.insertINTCONST(ident, v);
 }
 
 void VarDefAST::Dump(bool is_global) const{
-    ScopeHelper scope("VarDefAST", ident);
-    st.insertINT(ident);
-    string name = st.getName(ident);
+    TRACE_SCOPE("VarDefAST", idents.str(ident));
     if(is_global){
         if(init_val == nullptr){
-            ki.globalAllocINT(name);
+            st.insertINT(ident, ki.globalAllocINT());
         } else {
             int v = init_val->exp->getValue();
-            ki.globalAllocINT(name, to_string(v));
+            st.insertINT(ident, ki.globalAllocINT(ki.integer(v)));
         }
     } else {
-        ki.alloc(name);
+        IRValue *var = ki.alloc();
+        st.insertINT(ident, var);
         if(init_val != nullptr){
-            string s = init_val->Dump();
-            ki.store(s, name);
+            IRValue *s = init_val->Dump();
+            ki.store(s, var);
         }
     }
     return;
 }
 
-string InitValAST::Dump() const{
+IRValue *InitValAST::Dump() const{
     return exp->Dump();
 }
 
@@ -325,29 +283,24 @@ int ConstInitValAST::getValue(){
     return const_exp->getValue();
 }
 
-string LValAST::Dump(bool dump_ptr)const{
-    ScopeHelper scope("LValAST", ident);
-    SysYType *ty = st.getType(ident);
+IRValue *LValAST::Dump(bool dump_ptr)const{
+    TRACE_SCOPE("LValAST", idents.str(ident));
+    Symbol *sym = st.lookup(ident);   // 只查一次符号表
+    SysYType *ty = sym->ty;
     if(ty->ty == SysYType::SYSY_INT_CONST)
-        return to_string(st.getValue(ident));
+        return ki.integer(ty->value);
     else if(ty->ty == SysYType::SYSY_INT){
         if(dump_ptr == false){
-            string tmp = st.getTmpName();
-            ki.load(tmp, st.getName(ident));
-            return tmp;
+            return ki.load(sym->ir_value);
         } else {
-            return st.getName(ident);
+            return sym->ir_value;
         }
     } else {
         // func(ident)
         if(ty->value == -1){
-            string tmp = st.getTmpName();
-            ki.load(tmp, st.getName(ident));
-            return tmp;
+            return ki.load(sym->ir_value);
         }
-        string tmp = st.getTmpName();
-        ki.getelemptr(tmp, st.getName(ident), "0");
-        return tmp;
+        return ki.getelemptr(sym->ir_value, 0);
     }
 }
 
@@ -359,105 +312,135 @@ int ConstExpAST::getValue(){
     return exp->getValue();
 }
 
-string ExpAST::Dump() const {
-    ScopeHelper scope("ExpAST");
+// 按条件 v 跳转，常量条件直接跳到对应出口
+static void condBranch(IRValue *v, IRBasicBlock *t, IRBasicBlock *f){
+    if(v->tag == IRValue::INTEGER)
+        ki.jump(v->value ? t : f);
+    else
+        ki.br(v, t, f);
+}
+
+IRValue *ExpAST::Dump() const {
+    TRACE_SCOPE("ExpAST");
     return l_or_exp->Dump();
 }
+
+void ExpAST::DumpCond(IRBasicBlock *t, IRBasicBlock *f) const {
+    TRACE_SCOPE("ExpAST");
+    l_or_exp->DumpCond(t, f);
+}
  
 int ExpAST::getValue(){
     return l_or_exp->getValue();
 }
 
-string PrimaryExpAST::Dump() const{
+IRValue *PrimaryExpAST::Dump() const{
     switch (tag)
     {
         case PARENTHESES: {
-            ScopeHelper scope("PrimaryExpAST");
+            TRACE_SCOPE("PrimaryExpAST");
             return exp->Dump();
         }
         case NUMBER: {
-            ScopeHelper scope("PrimaryExpAST", to_string(number));
-            return to_string(number);
+            TRACE_SCOPE("PrimaryExpAST", number);
+            return ki.integer(number);
         }
         case LVAL: {
-            ScopeHelper scope("PrimaryExpAST");
+            TRACE_SCOPE("PrimaryExpAST");
             return lval->Dump();
         }
     }
-    return "";
+    return nullptr;
+}
+
+void PrimaryExpAST::DumpCond(IRBasicBlock *t, IRBasicBlock *f) const{
+    if(tag == PARENTHESES){
+        TRACE_SCOPE("PrimaryExpAST");
+        exp->DumpCond(t, f);
+        return;
+    }
+    condBranch(Dump(), t, f);
 }
 
 int PrimaryExpAST::getValue(){
     switch (tag)
     {
         case PARENTHESES: {
-            ScopeHelper scope("PrimaryExpAST");
+            TRACE_SCOPE("PrimaryExpAST");
             return exp->getValue();
         }
         case NUMBER: {
-            ScopeHelper scope("PrimaryExpAST", to_string(number));
+            TRACE_SCOPE("PrimaryExpAST", number);
             return number;
         }
         case LVAL: {
-            ScopeHelper scope("PrimaryExpAST");
+            TRACE_SCOPE("PrimaryExpAST");
             return lval->getValue();
         }
     }
     return -1;  // make g++ happy
 }
 
-string UnaryExpAST::Dump() const{
-    if(tag == OP_UNITARY_EXP ) ScopeHelper scope("UnaryExpAST");
+IRValue *UnaryExpAST::Dump() const{
+    if(tag == OP_UNITARY_EXP ) TRACE_SCOPE("UnaryExpAST");
 
     if(tag == PRIMARY_EXP)return primary_exp->Dump();
     else if(tag == OP_UNITARY_EXP){
-        string b = unary_exp->Dump();
+        IRValue *b = unary_exp->Dump();
         if(unary_op == '+') return b;
 
-        string op = unary_op == '-' ? "sub" : "eq";
-        string c = st.getTmpName();
-        ki.binary(op, c, "0", b);
-        return c;
+        IRValue::OP op = unary_op == '-' ? IRValue::OP_SUB : IRValue::OP_EQ;
+        return ki.binary(op, ki.integer(0), b);
     }else{
         // Func_Call
-        string name = st.getName(ident);
-        string tmp = "";
-        vector<string> par;
-        if(st.getType(ident)->ty == SysYType::SYSY_FUNC_INT){
-            tmp = st.getTmpName();
-        }
+        vector<IRValue *> par;
         if(func_params){
             int n = func_params->exps.size();
             for(int i = 0; i < n; ++i){
                 par.push_back(func_params->exps[i]->Dump());
             }
         }
-        ki.call(tmp, st.getName(ident), par);
-        return tmp;
+        return ki.call(st.getIRFunc(ident), par);
     }
 }
 
+void UnaryExpAST::DumpCond(IRBasicBlock *t, IRBasicBlock *f) const{
+    if(tag == PRIMARY_EXP)
+        primary_exp->DumpCond(t, f);
+    else if(tag == OP_UNITARY_EXP && unary_op == '!')
+        unary_exp->DumpCond(f, t);      // 交换真假出口
+    else
+        condBranch(Dump(), t, f);
+}
+
 int UnaryExpAST::getValue(){ 
     if(tag == PRIMARY_EXP) return primary_exp->getValue();
 
     int v =unary_exp->getValue();
     if(unary_op == '+') return v;
-    return unary_op == '-' ? -v : !v;
+    int res;
+    foldBinary(unary_op == '-' ? IRValue::OP_SUB : IRValue::OP_EQ, 0, v, res);
+    return res;
 }
 
-string MulExpAST::Dump() const{ 
-    if(tag != UNARY_EXP)ScopeHelper scope("MulExpAST");
+IRValue *MulExpAST::Dump() const{ 
+    if(tag != UNARY_EXP)TRACE_SCOPE("MulExpAST");
     if(tag == UNARY_EXP)return unary_exp->Dump();
-    string a, b, c;
+    IRValue *a, *b;
     
     a = mul_exp_1->Dump();
     b = unary_exp_2->Dump();
 
-    string op = mul_op == '*' ? "mul":(mul_op == '/' ?"div" : "mod");
+    IRValue::OP op = mul_op == '*' ? IRValue::OP_MUL :(mul_op == '/' ? IRValue::OP_DIV : IRValue::OP_MOD);
     
-    c = st.getTmpName();
-    ki.binary(op, c, a, b);
-    return c;
+    return ki.binary(op, a, b);
+}
+
+void MulExpAST::DumpCond(IRBasicBlock *t, IRBasicBlock *f) const{
+    if(tag == UNARY_EXP)
+        unary_exp->DumpCond(t, f);
+    else
+        condBranch(Dump(), t, f);
 }
 
 int MulExpAST::getValue(){
@@ -465,39 +448,55 @@ int MulExpAST::getValue(){
 
     int a = mul_exp_1->getValue(), b = unary_exp_2->getValue();
 
-    return mul_op == '*' ? a * b : (mul_op == '/' ? a / b : a % b);
+    IRValue::OP op = mul_op == '*' ? IRValue::OP_MUL :(mul_op == '/' ? IRValue::OP_DIV : IRValue::OP_MOD);
+    int res;
+    if(foldBinary(op, a, b, res))
+        return res;
+    return mul_op == '/' ? a / b : a % b;
 }
 
-string AddExpAST::Dump() const{
-    if(tag != MUL_EXP)ScopeHelper scope("AddExpAST");
+IRValue *AddExpAST::Dump() const{
+    if(tag != MUL_EXP)TRACE_SCOPE("AddExpAST");
     if(tag == MUL_EXP)return mul_exp->Dump();
-    string a, b, c;
+    IRValue *a, *b;
     
     a = add_exp_1->Dump();
     b = mul_exp_2->Dump();
 
-    string op = add_op == '+' ? "add" : "sub";
+    IRValue::OP op = add_op == '+' ? IRValue::OP_ADD : IRValue::OP_SUB;
     
-    c = st.getTmpName();
-    ki.binary(op, c, a, b);
-    return c;
+    return ki.binary(op, a, b);
+}
+
+void AddExpAST::DumpCond(IRBasicBlock *t, IRBasicBlock *f) const{
+    if(tag == MUL_EXP)
+        mul_exp->DumpCond(t, f);
+    else
+        condBranch(Dump(), t, f);
 }
 
 int AddExpAST::getValue(){
     if(tag == MUL_EXP) return mul_exp->getValue();
 
     int a = add_exp_1->getValue(), b = mul_exp_2->getValue();
-    return add_op == '+' ? a + b : a - b;
+    int res;
+    foldBinary(add_op == '+' ? IRValue::OP_ADD : IRValue::OP_SUB, a, b, res);
+    return res;
 }
 
-string RelExpAST::Dump() const {
-    if(tag != ADD_EXP)ScopeHelper scope("RelExpAST");
+IRValue *RelExpAST::Dump() const {
+    if(tag != ADD_EXP)TRACE_SCOPE("RelExpAST");
     if(tag == ADD_EXP) return add_exp->Dump();
-    string a = rel_exp_1->Dump(), b = add_exp_2->Dump();
-    string op = rel_op[1] == '=' ? (rel_op[0] == '<' ? "le" : "ge") : (rel_op[0] == '<' ? "lt" : "gt");
-    string dest = st.getTmpName();
-    ki.binary(op, dest, a, b);
-    return dest;
+    IRValue *a = rel_exp_1->Dump(), *b = add_exp_2->Dump();
+    IRValue::OP op = rel_op[1] == '=' ? (rel_op[0] == '<' ? IRValue::OP_LE : IRValue::OP_GE) : (rel_op[0] == '<' ? IRValue::OP_LT : IRValue::OP_GT);
+    return ki.binary(op, a, b);
+}
+
+void RelExpAST::DumpCond(IRBasicBlock *t, IRBasicBlock *f) const {
+    if(tag == ADD_EXP)
+        add_exp->DumpCond(t, f);
+    else
+        condBranch(Dump(), t, f);
 }
 
 int RelExpAST::getValue(){
@@ -510,14 +509,19 @@ int RelExpAST::getValue(){
     return rel_op[0] == '>' ? (a > b) : (a < b);
 }
 
-string EqExpAST::Dump() const {
-    if(tag != REL_EXP) ScopeHelper scope("EqExpAST");
+IRValue *EqExpAST::Dump() const {
+    if(tag != REL_EXP) TRACE_SCOPE("EqExpAST");
     if(tag == REL_EXP) return rel_exp->Dump();
-    string a = eq_exp_1->Dump(), b =rel_exp_2->Dump();
-    string op = eq_op == '=' ? "eq" : "ne";
-    string dest = st.getTmpName();
-    ki.binary(op, dest, a, b);
-    return dest;
+    IRValue *a = eq_exp_1->Dump(), *b =rel_exp_2->Dump();
+    IRValue::OP op = eq_op == '=' ? IRValue::OP_EQ : IRValue::OP_NOT_EQ;
+    return ki.binary(op, a, b);
+}
+
+void EqExpAST::DumpCond(IRBasicBlock *t, IRBasicBlock *f) const {
+    if(tag == REL_EXP)
+        rel_exp->DumpCond(t, f);
+    else
+        condBranch(Dump(), t, f);
 }
 
 int EqExpAST::getValue(){
@@ -526,34 +530,51 @@ int EqExpAST::getValue(){
     return eq_op == '=' ? (a == b) : (a != b);
 }
 
-string LAndExpAST::Dump() const {
-    if(tag != EQ_EXP) ScopeHelper scope("LAndExpAST");
+IRValue *LAndExpAST::Dump() const {
+    if(tag != EQ_EXP) TRACE_SCOPE("LAndExpAST");
     if(tag == EQ_EXP) return eq_exp->Dump();
     
     // 修改支持短路逻辑
-    string result = st.getVarName("SCRES");
-    ki.alloc(result);
-    ki.store("0", result);
+    IRValue *lhs = l_and_exp_1->Dump();
+    // 左边是常量时不需要分支
+    if(lhs->tag == IRValue::INTEGER){
+        if(lhs->value == 0)
+            return ki.integer(0);
+        return ki.binary(IRValue::OP_NOT_EQ, eq_exp_2->Dump(), ki.integer(0));
+    }
+    IRValue *result = ki.alloc(st.getVarName("SCRES"));
+    ki.store(ki.integer(0), result);
 
-    string lhs = l_and_exp_1->Dump();
-    string then_s = st.getLabelName("then_sc");
-    string end_s = st.getLabelName("end_sc");
+    IRBasicBlock *then_s = ki.block(st.getLabelName("then_sc"));
+    IRBasicBlock *end_s = ki.block(st.getLabelName("end_sc"));
 
     ki.br(lhs, then_s, end_s);
 
     bc.set();
     ki.label(then_s);
-    string rhs = eq_exp_2->Dump();
-    string tmp = st.getTmpName();
-    ki.binary("ne", tmp, rhs, "0");
+    IRValue *rhs = eq_exp_2->Dump();
+    IRValue *tmp = ki.binary(IRValue::OP_NOT_EQ, rhs, ki.integer(0));
     ki.store(tmp, result);
     ki.jump(end_s);
 
     bc.set();
     ki.label(end_s);
-    string ret = st.getTmpName();
-    ki.load(ret, result);
-    return ret;
+    return ki.load(result);
+}
+
+// 左边为假直接跳到 f，为真再判断右边
+void LAndExpAST::DumpCond(IRBasicBlock *t, IRBasicBlock *f) const {
+    if(tag == EQ_EXP){
+        eq_exp->DumpCond(t, f);
+        return;
+    }
+    TRACE_SCOPE("LAndExpAST");
+    IRBasicBlock *rhs = ki.block(st.getLabelName("then_sc"));
+    l_and_exp_1->DumpCond(rhs, f);
+
+    bc.set();
+    ki.label(rhs);
+    eq_exp_2->DumpCond(t, f);
 }
 
 int LAndExpAST::getValue(){
@@ -562,35 +583,51 @@ int LAndExpAST::getValue(){
     return a && b;  // 注意是逻辑与
 }
 
-string LOrExpAST::Dump() const {
-    if(tag != L_AND_EXP) ScopeHelper scope("LOrExpAST");
+IRValue *LOrExpAST::Dump() const {
+    if(tag != L_AND_EXP) TRACE_SCOPE("LOrExpAST");
     if(tag == L_AND_EXP) return l_and_exp->Dump();
 
     // 修改支持短路逻辑
-    string result = st.getVarName("SCRES");
-    ki.alloc(result);
-    ki.store("1", result);
-
-    string lhs = l_or_exp_1->Dump();
+    IRValue *lhs = l_or_exp_1->Dump();
+    // 左边是常量时不需要分支
+    if(lhs->tag == IRValue::INTEGER){
+        if(lhs->value != 0)
+            return ki.integer(1);
+        return ki.binary(IRValue::OP_NOT_EQ, l_and_exp_2->Dump(), ki.integer(0));
+    }
+    IRValue *result = ki.alloc(st.getVarName("SCRES"));
+    ki.store(ki.integer(1), result);
 
-    string then_s = st.getLabelName("then_sc");
-    string end_s = st.getLabelName("end_sc");
+    IRBasicBlock *then_s = ki.block(st.getLabelName("then_sc"));
+    IRBasicBlock *end_s = ki.block(st.getLabelName("end_sc"));
 
     ki.br(lhs, end_s, then_s);
 
     bc.set();
     ki.label(then_s);
-    string rhs = l_and_exp_2->Dump();
-    string tmp = st.getTmpName();
-    ki.binary("ne", tmp, rhs, "0");
+    IRValue *rhs = l_and_exp_2->Dump();
+    IRValue *tmp = ki.binary(IRValue::OP_NOT_EQ, rhs, ki.integer(0));
     ki.store(tmp, result);
     ki.jump(end_s);
 
     bc.set();
     ki.label(end_s);
-    string ret = st.getTmpName();
-    ki.load(ret, result);
-    return ret;
+    return ki.load(result);
+}
+
+// 左边为真直接跳到 t，为假再判断右边
+void LOrExpAST::DumpCond(IRBasicBlock *t, IRBasicBlock *f) const {
+    if(tag == L_AND_EXP){
+        l_and_exp->DumpCond(t, f);
+        return;
+    }
+    TRACE_SCOPE("LOrExpAST");
+    IRBasicBlock *rhs = ki.block(st.getLabelName("then_sc"));
+    l_or_exp_1->DumpCond(t, rhs);
+
+    bc.set();
+    ki.label(rhs);
+    l_and_exp_2->DumpCond(t, f);
 }
 
 int LOrExpAST::getValue() {
@@ -1,5 +1,8 @@
 #pragma once
 #include <bits/stdc++.h>
+#include "IR.h"
+#include "Arena.h"
+#include "Interner.h"
 // 所有类的声明
 class BaseAST; 
 class CompUnitAST;
@@ -38,6 +41,12 @@ class LOrExpAST;
 
 class FuncRParamsAST;
 
+// 所有 AST 节点和子节点列表都从 ast_arena 分配，标识符是 Interner 中的 id，整棵树一起释放
+// 节点之间用裸指针连接，不会单独析构
+extern Arena ast_arena;
+template<typename T>
+using ASTList = std::vector<T *, ArenaAllocator<T *, ast_arena>>;
+
 // 所有 AST 的基类
 class BaseAST {
 public:
@@ -48,8 +57,8 @@ public:
 // CompUnit      ::= [CompUnit] (Decl | FuncDef);
 class CompUnitAST : public BaseAST {     // 编译开始符
 public:
-    std::vector<std::unique_ptr<FuncDefAST>> func_defs; // 所有函数定义
-    std::vector<std::unique_ptr<DeclAST>> decls;    // 所有全局变量
+    ASTList<FuncDefAST> func_defs; // 所有函数定义
+    ASTList<DeclAST> decls;    // 所有全局变量
     void Dump()const;
     void DumpGlobalVar() const;
 };
@@ -57,33 +66,33 @@ public:
 // FuncDef       ::= FuncType IDENT "(" [FuncFParams] ")" Block;
 class FuncDefAST : public BaseAST {         // 定义函数的节点
 public:
-    std::unique_ptr<BTypeAST> btype;    // 返回值类型
-    std::string ident;                  // 函数名标识符
-    std::unique_ptr<FuncFParamsAST> func_params;    // 函数参数, nullptr则无参数
-    std::unique_ptr<BlockAST> block;    // 函数体
+    BTypeAST *btype = nullptr;              // 返回值类型
+    int ident = -1;                         // 函数名标识符的 id
+    FuncFParamsAST *func_params = nullptr;  // 函数参数, nullptr则无参数
+    BlockAST *block = nullptr;              // 函数体
     void Dump() const;
 };
 
 // FuncFParams   ::= FuncFParam {"," FuncFParam};
 class FuncFParamsAST : public BaseAST {     // 定义函数参数列表
 public:
-    std::vector<std::unique_ptr<FuncFParamAST>> func_f_params;
+    ASTList<FuncFParamAST> func_f_params;
     void Dump() const;
 };
 
 // FuncFParam    ::= BType IDENT;
 class FuncFParamAST : public BaseAST {      // 定义函数参数
 public:
-    std::unique_ptr<BTypeAST> btype;
-    std::string ident;
-    // 返回参数类型，即“i32”
-    std::string Dump() const;
+    BTypeAST *btype = nullptr;
+    int ident = -1;
+    // 返回参数类型，即 i32
+    IRType *Dump() const;
 };
 
 // Block         ::= "{" {BlockItem} "}";
 class BlockAST : public BaseAST {       // 单入口单出口的基本块
 public:
-    std::vector<std::unique_ptr<BlockItemAST>> block_items; // 基本块中有很多元素，vector装
+    ASTList<BlockItemAST> block_items; // 基本块中有很多元素，vector装
     // 进入 block 处理，传参默认为 true 表示新增一层符号表
     void Dump(bool new_symbol_tb = true) const;
 };
@@ -93,8 +102,8 @@ class BlockItemAST : public BaseAST {   // 块中的一个元素
 public:
     enum TAG {DECL, STMT};  // 可以是常量变量定义（decl），或者语句（stmt）
     TAG tag;
-    std::unique_ptr<DeclAST> decl;
-    std::unique_ptr<StmtAST> stmt;
+    DeclAST *decl = nullptr;
+    StmtAST *stmt = nullptr;
     void Dump() const;
 };
 
@@ -103,8 +112,8 @@ class DeclAST : public BaseAST {        // 定义常量或变量
 public:
     enum TAG {CONST_DECL, VAR_DECL};
     TAG tag;
-    std::unique_ptr<ConstDeclAST> const_decl;
-    std::unique_ptr<VarDeclAST> var_decl;
+    ConstDeclAST *const_decl = nullptr;
+    VarDeclAST *var_decl = nullptr;
     void Dump() const;
 };
 
@@ -120,12 +129,12 @@ class StmtAST : public BaseAST {
 public:
     enum TAG {RETURN, ASSIGN, BLOCK, EXP, WHILE, BREAK, CONTINUE, IF};
     TAG tag; // 语句可能是以上的某一种，是哪种就用下面的所需要的类
-    std::unique_ptr<ExpAST> exp;
-    std::unique_ptr<LValAST> lval;
-    std::unique_ptr<BlockAST> block;
-    std::unique_ptr<StmtAST> stmt;
-    std::unique_ptr<StmtAST> if_stmt;
-    std::unique_ptr<StmtAST> else_stmt;  
+    ExpAST *exp = nullptr;
+    LValAST *lval = nullptr;
+    BlockAST *block = nullptr;
+    StmtAST *stmt = nullptr;
+    StmtAST *if_stmt = nullptr;
+    StmtAST *else_stmt = nullptr;  
 /*
     StmtAST::Dump 方法处理不同类型的语句格式，每种语句类型都对应一个格式：
 
@@ -161,16 +170,16 @@ public:
 // ConstDecl     ::= "const" BType ConstDef {"," ConstDef} ";";
 class ConstDeclAST : public BaseAST {
 public:
-    std::vector<std::unique_ptr<ConstDefAST>> const_defs;
-    std::unique_ptr<BTypeAST> btype;
+    ASTList<ConstDefAST> const_defs;
+    BTypeAST *btype = nullptr;
     void Dump() const;
 };
 
 // VarDecl       ::= BType VarDef {"," VarDef} ";";
 class VarDeclAST : public BaseAST {
 public:
-    std::vector<std::unique_ptr<VarDefAST>> var_defs;
-    std::unique_ptr<BTypeAST> btype;
+    ASTList<VarDefAST> var_defs;
+    BTypeAST *btype = nullptr;
     void Dump() const;
 };
 
@@ -179,14 +188,15 @@ class BTypeAST : public BaseAST {
 public:
     enum TAG {VOID, INT};
     TAG tag;
-    void Dump() const;
+    // 返回对应的 IR 类型，i32 或 unit
+    IRType *Dump() const;
 };
 
 // ConstDef      ::= IDENT {"[" ConstExp "]"} "=" ConstInitVal;
 class ConstDefAST : public BaseAST {
 public:
-    std::string ident;
-    std::unique_ptr<ConstInitValAST> const_init_val;
+    int ident = -1;
+    ConstInitValAST *const_init_val = nullptr;
     void Dump(bool is_global = false) const;
 };
 
@@ -194,22 +204,22 @@ public:
 //                 | IDENT {"[" ConstExp "]"} "=" InitVal;
 class VarDefAST: public BaseAST {
 public:
-    std::string ident;
-    std::unique_ptr<InitValAST> init_val;   // nullptr implies no init_val
+    int ident = -1;
+    InitValAST *init_val = nullptr;   // nullptr implies no init_val
     void Dump(bool is_global = false) const;
 };
 
 // InitVal       ::= Exp
 class InitValAST : public BaseAST{
 public:
-    std::unique_ptr<ExpAST> exp;
-    std::string Dump() const;
+    ExpAST *exp = nullptr;
+    IRValue *Dump() const;
 };
 
 // ConstInitVal  ::= ConstExp;
 class ConstInitValAST : public BaseAST {
 public:
-    std::unique_ptr<ConstExpAST> const_exp;
+    ConstExpAST *const_exp = nullptr;
     // 表达式求值，计算结果放在pi所指的int内存地址
     int getValue();
 };
@@ -217,25 +227,27 @@ public:
 // LVal          ::= IDENT;
 class LValAST : public BaseAST {
 public:
-    std::string ident;
-    // false 时返回存有该值的临时变量（寄存器），true时返回KoopaIR变量名，默认为false
-    std::string Dump(bool dump_ptr = false) const;
+    int ident = -1;
+    // false 时返回存有该值的临时变量（寄存器），true时返回KoopaIR变量（指针），默认为false
+    IRValue *Dump(bool dump_ptr = false) const;
     int getValue();
 };
 
 // ConstExp      ::= Exp;
 class ConstExpAST : public BaseAST {
 public:
-    std::unique_ptr<ExpAST> exp;
+    ExpAST *exp = nullptr;
     int getValue();
 };
 
 // Exp           ::= LOrExp;
 class ExpAST : public BaseAST {
 public:
-    std::unique_ptr<LOrExpAST> l_or_exp;
-    // 生成计算表达式的值的中间代码，返回存储该值的寄存器
-    std::string Dump() const;
+    LOrExpAST *l_or_exp = nullptr;
+    // 生成计算表达式的值的中间代码，返回存储该值的 IR 值
+    IRValue *Dump() const;
+    // 作为条件时直接生成跳转，为真跳到 t，为假跳到 f
+    void DumpCond(IRBasicBlock *t, IRBasicBlock *f) const;
     // 直接返回表达式的值
     int getValue(); 
 };
@@ -245,10 +257,11 @@ class PrimaryExpAST : public BaseAST { // 表达式成员，可以是另一个
 public:
     enum TAG { PARENTHESES, NUMBER, LVAL};
     TAG tag;
-    std::unique_ptr<ExpAST> exp;
-    std::unique_ptr<LValAST> lval;
+    ExpAST *exp = nullptr;
+    LValAST *lval = nullptr;
     int number;
-    std::string Dump() const ;
+    IRValue *Dump() const;
+    void DumpCond(IRBasicBlock *t, IRBasicBlock *f) const;
     int getValue();
 };
 
@@ -258,12 +271,13 @@ class UnaryExpAST : public BaseAST { //处理一元运算+,-,!正负非，否则
 public:
     enum TAG { PRIMARY_EXP, OP_UNITARY_EXP, FUNC_CALL};
     TAG tag;
-    std::unique_ptr<PrimaryExpAST> primary_exp;
+    PrimaryExpAST *primary_exp = nullptr;
     char unary_op;
-    std::unique_ptr<UnaryExpAST> unary_exp;
-    std::string ident;
-    std::unique_ptr<FuncRParamsAST> func_params;
-    std::string Dump() const;
+    UnaryExpAST *unary_exp = nullptr;
+    int ident = -1;
+    FuncRParamsAST *func_params = nullptr;
+    IRValue *Dump() const;
+    void DumpCond(IRBasicBlock *t, IRBasicBlock *f) const;
     int getValue();
 };
 
@@ -272,11 +286,12 @@ class MulExpAST : public BaseAST { //处理乘,除,取模运算，否则交给
 public:
     enum TAG {UNARY_EXP, OP_MUL_EXP};
     TAG tag;
-    std::unique_ptr<UnaryExpAST> unary_exp;
-    std::unique_ptr<MulExpAST> mul_exp_1;
-    std::unique_ptr<UnaryExpAST> unary_exp_2;
+    UnaryExpAST *unary_exp = nullptr;
+    MulExpAST *mul_exp_1 = nullptr;
+    UnaryExpAST *unary_exp_2 = nullptr;
     char mul_op;
-    std::string Dump() const;
+    IRValue *Dump() const;
+    void DumpCond(IRBasicBlock *t, IRBasicBlock *f) const;
     int getValue();
 };
 
@@ -285,11 +300,12 @@ class AddExpAST : public BaseAST { //处理加减，否则交给上层mul_exp模
 public:
     enum TAG {MUL_EXP, OP_ADD_EXP};
     TAG tag;
-    std::unique_ptr<MulExpAST> mul_exp;
-    std::unique_ptr<AddExpAST> add_exp_1;
-    std::unique_ptr<MulExpAST> mul_exp_2;
+    MulExpAST *mul_exp = nullptr;
+    AddExpAST *add_exp_1 = nullptr;
+    MulExpAST *mul_exp_2 = nullptr;
     char add_op;
-    std::string Dump() const;
+    IRValue *Dump() const;
+    void DumpCond(IRBasicBlock *t, IRBasicBlock *f) const;
     int getValue();
 };
 
@@ -298,11 +314,12 @@ class RelExpAST : public BaseAST { //处理大小比较，否则交给上层add_
 public:
     enum TAG {ADD_EXP, OP_REL_EXP};
     TAG tag;
-    std::unique_ptr<AddExpAST> add_exp;
-    std::unique_ptr<RelExpAST> rel_exp_1;
-    std::unique_ptr<AddExpAST> add_exp_2;
+    AddExpAST *add_exp = nullptr;
+    RelExpAST *rel_exp_1 = nullptr;
+    AddExpAST *add_exp_2 = nullptr;
     char rel_op[2];     // <,>,<=,>=
-    std::string Dump() const;
+    IRValue *Dump() const;
+    void DumpCond(IRBasicBlock *t, IRBasicBlock *f) const;
     int getValue();
 };
 
@@ -311,11 +328,12 @@ class EqExpAST : public BaseAST {//处理相等或不等，否则给上层rel_ex
 public:
     enum TAG {REL_EXP, OP_EQ_EXP};
     TAG tag;
-    std::unique_ptr<RelExpAST> rel_exp;
-    std::unique_ptr<EqExpAST> eq_exp_1;
-    std::unique_ptr<RelExpAST> rel_exp_2;
+    RelExpAST *rel_exp = nullptr;
+    EqExpAST *eq_exp_1 = nullptr;
+    RelExpAST *rel_exp_2 = nullptr;
     char eq_op;     // =,!
-    std::string Dump() const;
+    IRValue *Dump() const;
+    void DumpCond(IRBasicBlock *t, IRBasicBlock *f) const;
     int getValue();
 };
 
@@ -324,10 +342,11 @@ class LAndExpAST : public BaseAST { //处理与，否则给上层eq_exp模块
 public:
     enum TAG {EQ_EXP, OP_L_AND_EXP};
     TAG tag;
-    std::unique_ptr<EqExpAST> eq_exp;
-    std::unique_ptr<LAndExpAST> l_and_exp_1;
-    std::unique_ptr<EqExpAST> eq_exp_2;
-    std::string Dump() const;
+    EqExpAST *eq_exp = nullptr;
+    LAndExpAST *l_and_exp_1 = nullptr;
+    EqExpAST *eq_exp_2 = nullptr;
+    IRValue *Dump() const;
+    void DumpCond(IRBasicBlock *t, IRBasicBlock *f) const;
     int getValue();
 };
 
@@ -336,16 +355,17 @@ class LOrExpAST : public BaseAST { //处理或，否则给上层l_and_exp模块
 public:
     enum TAG {L_AND_EXP, OP_L_OR_EXP};
     TAG tag;
-    std::unique_ptr<LAndExpAST> l_and_exp;
-    std::unique_ptr<LOrExpAST> l_or_exp_1;
-    std::unique_ptr<LAndExpAST> l_and_exp_2;
-    std::string Dump() const;
+    LAndExpAST *l_and_exp = nullptr;
+    LOrExpAST *l_or_exp_1 = nullptr;
+    LAndExpAST *l_and_exp_2 = nullptr;
+    IRValue *Dump() const;
+    void DumpCond(IRBasicBlock *t, IRBasicBlock *f) const;
     int getValue();
 };
 
 // FuncRParams   ::= Exp {"," Exp};
 class FuncRParamsAST : public BaseAST {
 public:
-    std::vector<std::unique_ptr<ExpAST>> exps;  // 函数表达式的参数
+    ASTList<ExpAST> exps;  // 函数表达式的参数
     std::string Dump() const;
 };
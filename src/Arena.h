@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+按块分配的内存池，只能整体释放
+AST 节点、节点中的列表和标识符文本都放在这里，语法树用完之后 release() 一次释放
+放在 Arena 中的对象不会调用析构函数，所以其中的成员也必须从 Arena 分配内存
+*/
+class Arena{
+private:
+    std::vector<char *> chunks;
+    char *cur = nullptr, *end = nullptr;
+    size_t chunk_size;
+
+    void grow(size_t size){
+        size_t n = size > chunk_size ? size : chunk_size;
+        char *p = (char *)std::malloc(n);
+        if(p == nullptr)
+            throw std::bad_alloc();
+        chunks.push_back(p);
+        cur = p;
+        end = p + n;
+    }
+public:
+    explicit Arena(size_t _chunk_size = 1 << 16): chunk_size(_chunk_size){}
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena(){ release(); }
+
+    void *alloc(size_t size, size_t align = alignof(std::max_align_t)){
+        size_t pad = (align - (size_t)cur % align) % align;
+        if(cur == nullptr || size + pad > (size_t)(end - cur)){
+            grow(size + align);
+            pad = (align - (size_t)cur % align) % align;
+        }
+        void *p = cur + pad;
+        cur += pad + size;
+        return p;
+    }
+
+    template<typename T, typename... Args>
+    T *make(Args &&...args){
+        return new (alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // 复制长度为 n 的字符串，末尾补 '\0'
+    const char *strdup(const char *s, size_t n){
+        char *p = (char *)alloc(n + 1, 1);
+        std::memcpy(p, s, n);
+        p[n] = '\0';
+        return p;
+    }
+
+    // 释放所有内存，之前分配的指针全部失效
+    void release(){
+        for(auto p : chunks)
+            std::free(p);
+        chunks.clear();
+        cur = end = nullptr;
+    }
+};
+
+// 从 arena 中分配内存的 allocator，deallocate 什么都不做
+template<typename T, Arena &arena>
+class ArenaAllocator{
+public:
+    using value_type = T;
+    ArenaAllocator() = default;
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U, arena> &){}
+    template<typename U>
+    struct rebind{ using other = ArenaAllocator<U, arena>; };
+
+    T *allocate(size_t n){
+        return (T *)arena.alloc(n * sizeof(T), alignof(T));
+    }
+    void deallocate(T *, size_t){}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U, arena> &) const { return true; }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U, arena> &) const { return false; }
+};
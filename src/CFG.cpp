@@ -0,0 +1,286 @@
+#include "CFG.h"
+#include <algorithm>
+#include <cstdint>
+using namespace std;
+
+vector<IRBasicBlock *> CFG::successors(IRBasicBlock *bb){
+    if(bb->insts.empty())
+        return {};
+    IRValue *term = bb->insts.back();
+    if(term->tag == IRValue::BRANCH)
+        return {term->target[0], term->target[1]};
+    if(term->tag == IRValue::JUMP)
+        return {term->target[0]};
+    return {};
+}
+
+CFG::CFG(IRFunction *func){
+    // 非递归 DFS 求后序
+    vector<IRBasicBlock *> post;
+    unordered_map<IRBasicBlock *, bool> visited;
+    vector<pair<IRBasicBlock *, vector<IRBasicBlock *>>> st;
+    IRBasicBlock *entry = func->bbs[0];
+    visited[entry] = true;
+    st.emplace_back(entry, successors(entry));
+    while(!st.empty()){
+        auto &top = st.back();
+        if(top.second.empty()){
+            post.push_back(top.first);
+            st.pop_back();
+            continue;
+        }
+        // 按 target 顺序访问，从后往前弹出
+        IRBasicBlock *s = top.second.front();
+        top.second.erase(top.second.begin());
+        if(!visited[s]){
+            visited[s] = true;
+            st.emplace_back(s, successors(s));
+        }
+    }
+    rpo.assign(post.rbegin(), post.rend());
+    size_t n = rpo.size();
+    for(size_t i = 0; i < n; ++i)
+        index[rpo[i]] = i;
+
+    preds.resize(n);
+    succs.resize(n);
+    for(size_t i = 0; i < n; ++i){
+        for(auto s : successors(rpo[i])){
+            int j = index[s];
+            succs[i].push_back(j);
+            preds[j].push_back(i);
+        }
+    }
+
+    // Cooper, Harvey, Kennedy: A Simple, Fast Dominance Algorithm
+    idom.assign(n, -1);
+    idom[0] = 0;
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(size_t b = 1; b < n; ++b){
+            int new_idom = -1;
+            for(int p : preds[b]){
+                if(idom[p] < 0)
+                    continue;
+                if(new_idom < 0){
+                    new_idom = p;
+                    continue;
+                }
+                int x = p, y = new_idom;
+                while(x != y){
+                    while(x > y) x = idom[x];
+                    while(y > x) y = idom[y];
+                }
+                new_idom = x;
+            }
+            if(idom[b] != new_idom){
+                idom[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    children.resize(n);
+    depth.assign(n, 0);
+    for(size_t b = 1; b < n; ++b){
+        children[idom[b]].push_back(b);
+        depth[b] = depth[idom[b]] + 1;     // 逆后序中 idom 一定在前面
+    }
+
+    // 支配边界
+    df.resize(n);
+    for(size_t b = 0; b < n; ++b){
+        if(preds[b].size() < 2)
+            continue;
+        for(int p : preds[b]){
+            int runner = p;
+            while(runner != idom[b]){
+                if(df[runner].empty() || df[runner].back() != (int)b)
+                    df[runner].push_back(b);
+                runner = idom[runner];
+            }
+        }
+    }
+}
+
+bool CFG::dominates(int a, int b) const{
+    while(depth[b] > depth[a])
+        b = idom[b];
+    return a == b;
+}
+
+bool Loop::contains(int b) const{
+    return binary_search(blocks.begin(), blocks.end(), b);
+}
+
+vector<Loop> findLoops(const CFG &cfg){
+    vector<Loop> loops;
+    vector<int> loop_of(cfg.size(), -1);    // header -> loops 中的下标
+    for(size_t b = 0; b < cfg.size(); ++b){
+        for(int h : cfg.succs[b]){
+            if(!cfg.dominates(h, b))
+                continue;
+            if(loop_of[h] < 0){
+                loop_of[h] = loops.size();
+                loops.push_back(Loop{h, {}, {}});
+            }
+            loops[loop_of[h]].latches.push_back(b);
+        }
+    }
+    sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b){
+        return a.header < b.header;
+    });
+    // 从回边的起点逆着边走，不经过 header
+    for(auto &loop : loops){
+        vector<bool> in(cfg.size(), false);
+        in[loop.header] = true;
+        vector<int> work;
+        for(int l : loop.latches){
+            if(!in[l]){
+                in[l] = true;
+                work.push_back(l);
+            }
+        }
+        while(!work.empty()){
+            int b = work.back();
+            work.pop_back();
+            for(int p : cfg.preds[b]){
+                if(!in[p]){
+                    in[p] = true;
+                    work.push_back(p);
+                }
+            }
+        }
+        for(size_t b = 0; b < cfg.size(); ++b){
+            if(in[b])
+                loop.blocks.push_back(b);
+        }
+    }
+    return loops;
+}
+
+vector<int> loopDepth(const CFG &cfg, const vector<Loop> &loops){
+    vector<int> depth(cfg.size(), 0);
+    for(auto &loop : loops){
+        for(int b : loop.blocks)
+            ++depth[b];
+    }
+    return depth;
+}
+
+IRBasicBlock *preheader(IRFunction *func, const CFG &cfg, const Loop &loop){
+    IRBasicBlock *header = cfg.rpo[loop.header];
+    vector<IRBasicBlock *> outside;
+    for(int p : cfg.preds[loop.header]){
+        if(!loop.contains(p))
+            outside.push_back(cfg.rpo[p]);
+    }
+    if(outside.size() == 1 && outside[0]->insts.back()->tag == IRValue::JUMP)
+        return outside[0];
+
+    IRBasicBlock *pre = func->newBasicBlock(header->name + "_pre");
+    IRValue *jump = func->newValue(IRValue::JUMP, IRType::getUnit());
+    for(auto hp : header->params){
+        IRValue *p = func->newValue(IRValue::BLOCK_ARG_REF, hp->ty);
+        p->value = pre->params.size();
+        p->bb = pre;
+        pre->params.push_back(p);
+        jump->ops.push_back(p);
+    }
+    jump->target[0] = header;
+    jump->bb = pre;
+    pre->insts.push_back(jump);
+    for(auto bb : outside){
+        IRValue *term = bb->insts.back();
+        for(int t = 0; t < 2; ++t){
+            if(term->target[t] == header)
+                term->target[t] = pre;
+        }
+    }
+    func->bbs.insert(find(func->bbs.begin(), func->bbs.end(), header), pre);
+    return pre;
+}
+
+IRValue *baseObject(IRValue *addr){
+    while(addr->tag == IRValue::GET_ELEM_PTR || addr->tag == IRValue::GET_PTR)
+        addr = addr->ops[0];
+    return addr->tag == IRValue::ALLOC || addr->tag == IRValue::GLOBAL_ALLOC ? addr : nullptr;
+}
+
+bool mayPointToFrame(IRValue *v){
+    if(v->ty->tag != IRType::POINTER)
+        return false;
+    while(v->tag == IRValue::GET_ELEM_PTR || v->tag == IRValue::GET_PTR)
+        v = v->ops[0];
+    return v->tag == IRValue::ALLOC || v->tag == IRValue::BLOCK_ARG_REF;
+}
+
+bool mayAlias(IRValue *p, IRValue *q){
+    if(p == q)
+        return true;
+    IRValue *a = baseObject(p), *b = baseObject(q);
+    return a == nullptr || b == nullptr || a == b;
+}
+
+bool stepOf(IRValue *v, IRValue *i, int &step){
+    if(v->tag != IRValue::BINARY)
+        return false;
+    IRValue *a = v->ops[0], *b = v->ops[1];
+    if(v->op == IRValue::OP_ADD && b == i && a->tag == IRValue::INTEGER)
+        swap(a, b);
+    if(a != i || b->tag != IRValue::INTEGER)
+        return false;
+    if(v->op == IRValue::OP_ADD)
+        step = b->value;
+    else if(v->op == IRValue::OP_SUB && b->value != INT32_MIN)
+        step = -b->value;
+    else
+        return false;
+    return true;
+}
+
+void removeUnreachable(IRFunction *func){
+    CFG cfg(func);
+    if(cfg.size() == func->bbs.size())
+        return;
+    vector<IRBasicBlock *> bbs;
+    for(auto bb : func->bbs){
+        if(cfg.reachable(bb))
+            bbs.push_back(bb);
+    }
+    func->bbs = bbs;
+}
+
+void removeBlockParams(IRFunction *func, const unordered_set<IRValue *> &dead){
+    if(dead.empty())
+        return;
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            int k = v->tag == IRValue::BRANCH ? 2 : v->tag == IRValue::JUMP ? 1 : 0;
+            for(int t = 0; t < k; ++t){
+                auto &params = v->target[t]->params;
+                vector<IRValue *> args = v->getArgs(t), kept;
+                bool changed = false;
+                for(size_t i = 0; i < args.size(); ++i){
+                    if(dead.count(params[i]))
+                        changed = true;
+                    else
+                        kept.push_back(args[i]);
+                }
+                if(changed)
+                    v->setArgs(t, kept);
+            }
+        }
+    }
+    for(auto bb : func->bbs){
+        vector<IRValue *> ps;
+        for(auto p : bb->params){
+            if(!dead.count(p)){
+                p->value = ps.size();
+                ps.push_back(p);
+            }
+        }
+        bb->params = ps;
+    }
+}
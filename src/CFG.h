@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "IR.h"
+
+/*
+函数的控制流图分析
+只包含从入口可达的基本块，按逆后序编号，入口为 0
+idom 为直接支配者（入口的 idom 是它自己），children 为支配树上的孩子，df 为支配边界
+构造之后修改了函数的控制流需要重新构造
+*/
+class CFG{
+public:
+    std::vector<IRBasicBlock *> rpo;
+    std::unordered_map<IRBasicBlock *, int> index;
+    std::vector<std::vector<int>> preds, succs;
+    std::vector<int> idom;
+    std::vector<std::vector<int>> children;
+    std::vector<std::vector<int>> df;
+
+    explicit CFG(IRFunction *func);
+
+    size_t size() const { return rpo.size(); }
+    bool reachable(IRBasicBlock *bb) const { return index.count(bb) != 0; }
+    // a 是否支配 b
+    bool dominates(int a, int b) const;
+
+    // 基本块的后继，按 target 的顺序
+    static std::vector<IRBasicBlock *> successors(IRBasicBlock *bb);
+
+private:
+    std::vector<int> depth;     // 在支配树上的深度
+};
+
+// 自然循环，编号都是 CFG 中的编号
+// 同一个 header 的所有回边合并为一个循环
+struct Loop{
+    int header;
+    std::vector<int> latches;   // 回边的起点
+    std::vector<int> blocks;    // 循环中的块，包括 header，按编号排序
+    bool contains(int b) const;
+};
+
+// 找出所有自然循环，按 header 的逆后序排列，外层循环在内层之前
+std::vector<Loop> findLoops(const CFG &cfg);
+
+// 每个块所在循环的嵌套深度，不在循环中为 0
+std::vector<int> loopDepth(const CFG &cfg, const std::vector<Loop> &loops);
+
+// 循环外进入 header 的块：header 在循环外只有一个以 jump 结尾的前驱时就是它，
+// 否则新建一个参数和 header 相同的块，循环外的前驱都改为跳到它
+IRBasicBlock *preheader(IRFunction *func, const CFG &cfg, const Loop &loop);
+
+// 地址指向的对象：沿 getelemptr/getptr 找到 alloc 或全局变量，找不到时返回 nullptr
+IRValue *baseObject(IRValue *addr);
+
+// 两个地址是否可能指向同一位置，基址是不同的 alloc/全局变量时不会，其余的都视为可能
+bool mayAlias(IRValue *p, IRValue *q);
+
+// 指针是否可能指向当前函数的栈帧：基址是 alloc，或者是来源不确定的块参数
+bool mayPointToFrame(IRValue *v);
+
+// v 是否为 i 加上（或减去）一个常量，是时 step 为 i 每次增加的量
+bool stepOf(IRValue *v, IRValue *i, int &step);
+
+// 删除从入口不可达的基本块
+void removeUnreachable(IRFunction *func);
+
+// 删除 dead 中的块参数，以及所有跳转中传给它们的值
+void removeBlockParams(IRFunction *func, const std::unordered_set<IRValue *> &dead);
@@ -0,0 +1,85 @@
+#include "Pass.h"
+#include "CFG.h"
+#include <unordered_map>
+using namespace std;
+
+/*
+mem2reg 之后的常量传播
+前端只能折叠字面量和常量，变量提升为 SSA 值之后又会出现新的常量运算
+1. 所有入边传入同一个值（不算自己）的块参数替换为这个值
+2. 操作数都是常量的二元运算折叠为常量，除数为 0 时保留
+反复进行直到不再变化
+*/
+
+static IRValue *resolve(const unordered_map<IRValue *, IRValue *> &replace, IRValue *v){
+    auto it = replace.find(v);
+    while(it != replace.end()){
+        v = it->second;
+        it = replace.find(v);
+    }
+    return v;
+}
+
+void constFold(IRProgram &program, IRFunction *func){
+    unordered_map<IRValue *, IRValue *> replace;
+    bool changed = true;
+    while(changed){
+        changed = false;
+
+        // 每个块参数收到的值
+        unordered_map<IRValue *, vector<IRValue *>> incoming;
+        for(auto bb : func->bbs){
+            if(bb->insts.empty())
+                continue;
+            IRValue *term = bb->insts.back();
+            int k = term->tag == IRValue::BRANCH ? 2 : term->tag == IRValue::JUMP ? 1 : 0;
+            for(int t = 0; t < k; ++t){
+                auto &params = term->target[t]->params;
+                vector<IRValue *> args = term->getArgs(t);
+                for(size_t i = 0; i < args.size(); ++i)
+                    incoming[params[i]].push_back(args[i]);
+            }
+        }
+        unordered_set<IRValue *> dead;
+        for(auto bb : func->bbs){
+            for(auto p : bb->params){
+                IRValue *same = nullptr;
+                bool unique = true;
+                for(auto a : incoming[p]){
+                    a = resolve(replace, a);
+                    if(a == p || a == same)
+                        continue;
+                    if(same != nullptr){
+                        unique = false;
+                        break;
+                    }
+                    same = a;
+                }
+                if(unique && same != nullptr){
+                    replace[p] = same;
+                    dead.insert(p);
+                }
+            }
+        }
+        removeBlockParams(func, dead);
+        changed |= !dead.empty();
+
+        for(auto bb : func->bbs){
+            vector<IRValue *> insts;
+            for(auto v : bb->insts){
+                for(auto &op : v->ops)
+                    op = resolve(replace, op);
+                int res;
+                if(v->tag == IRValue::BINARY && v->ops[0]->tag == IRValue::INTEGER
+                    && v->ops[1]->tag == IRValue::INTEGER
+                    && foldBinary(v->op, v->ops[0]->value, v->ops[1]->value, res)){
+                    replace[v] = program.getInteger(res);
+                    changed = true;
+                    continue;
+                }
+                insts.push_back(v);
+            }
+            bb->insts = insts;
+        }
+    }
+}
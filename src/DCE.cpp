@@ -0,0 +1,257 @@
+#include "Pass.h"
+#include "CFG.h"
+#include <unordered_map>
+#include <unordered_set>
+using namespace std;
+
+/*
+死代码删除
+从有副作用的指令出发沿操作数标记用到的值，没有被标记的指令和块参数都删除
+有副作用的指令：call、跳转、ret，以及写到会被读取的内存的 store
+只被 store 写入、从不被读取的 alloc（地址只用于 store 的目标和再次取元素地址）上的 store 也是死的
+块参数被标记时，所有跳转中传给它的值也被标记
+
+控制流化简，反复进行直到不再变化
+1. 条件为常量的 br 改为 jump
+2. 只有一条 jump、没有块参数的空块，前驱直接跳到 jump 的目标，
+   br 的两边跳过空块之后到达同一个块并且传的值相同时改为 jump
+3. 唯一前驱以 jump 结尾的块合并到前驱中，块参数替换为传入的值
+4. 删除不可达的块
+*/
+
+static bool isAddr(IRValue *v){
+    return v->tag == IRValue::GET_ELEM_PTR || v->tag == IRValue::GET_PTR;
+}
+
+// 只被写入、内容从不被读取的 alloc
+static unordered_set<IRValue *> writeOnlyAllocs(IRFunction *func){
+    unordered_set<IRValue *> read;
+    unordered_map<IRValue *, IRValue *> base;   // 地址 -> 它指向的 alloc
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            if(v->tag == IRValue::ALLOC)
+                base[v] = v;
+            else if(isAddr(v) && base.count(v->ops[0]))
+                base[v] = base[v->ops[0]];
+        }
+    }
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            for(size_t i = 0; i < v->ops.size(); ++i){
+                auto it = base.find(v->ops[i]);
+                if(it == base.end())
+                    continue;
+                bool write = (v->tag == IRValue::STORE && i == 1) || (isAddr(v) && i == 0);
+                if(!write)
+                    read.insert(it->second);
+            }
+        }
+    }
+    unordered_set<IRValue *> res;
+    for(auto &kv : base){
+        if(kv.first == kv.second && !read.count(kv.first))
+            res.insert(kv.first);
+    }
+    return res;
+}
+
+// 沿 getelemptr/getptr 找到地址指向的 alloc
+static IRValue *allocOf(IRValue *addr){
+    while(isAddr(addr))
+        addr = addr->ops[0];
+    return addr->tag == IRValue::ALLOC ? addr : nullptr;
+}
+
+void dce(IRFunction *func){
+    auto write_only = writeOnlyAllocs(func);
+    // 每个块参数收到的值
+    unordered_map<IRValue *, vector<IRValue *>> incoming;
+    for(auto bb : func->bbs){
+        if(bb->insts.empty())
+            continue;
+        IRValue *term = bb->insts.back();
+        int k = term->tag == IRValue::BRANCH ? 2 : term->tag == IRValue::JUMP ? 1 : 0;
+        for(int t = 0; t < k; ++t){
+            auto &params = term->target[t]->params;
+            vector<IRValue *> args = term->getArgs(t);
+            for(size_t i = 0; i < args.size(); ++i)
+                incoming[params[i]].push_back(args[i]);
+        }
+    }
+
+    unordered_set<IRValue *> live;
+    vector<IRValue *> work;
+    auto mark = [&](IRValue *v){
+        if(live.insert(v).second)
+            work.push_back(v);
+    };
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            switch(v->tag){
+                case IRValue::STORE:
+                    if(!write_only.count(allocOf(v->ops[1])))
+                        mark(v);
+                    break;
+                case IRValue::CALL:
+                case IRValue::RETURN:
+                    mark(v);
+                    break;
+                case IRValue::BRANCH:
+                    // 块参数收到的值等块参数被标记时再标记
+                    mark(v->ops[0]);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    while(!work.empty()){
+        IRValue *v = work.back();
+        work.pop_back();
+        if(v->tag == IRValue::BLOCK_ARG_REF){
+            for(auto a : incoming[v])
+                mark(a);
+        } else if(v->tag != IRValue::BRANCH && v->tag != IRValue::JUMP){
+            for(auto op : v->ops)
+                mark(op);
+        }
+    }
+
+    unordered_set<IRValue *> dead;
+    for(auto bb : func->bbs){
+        for(auto p : bb->params){
+            if(!live.count(p))
+                dead.insert(p);
+        }
+    }
+    removeBlockParams(func, dead);
+    for(auto bb : func->bbs){
+        vector<IRValue *> insts;
+        for(auto v : bb->insts){
+            if(live.count(v) || v->isTerminator())
+                insts.push_back(v);
+        }
+        bb->insts = insts;
+    }
+}
+
+// 把 br 改为跳到 bb 的 jump
+static void toJump(IRValue *br, IRBasicBlock *bb, const vector<IRValue *> &args){
+    br->tag = IRValue::JUMP;
+    br->target[0] = bb;
+    br->target[1] = nullptr;
+    br->true_args = 0;
+    br->ops = args;
+}
+
+void simplifyCFG(IRFunction *func){
+    bool changed = true;
+    while(changed){
+        changed = false;
+
+        // 1. 常量条件的 br
+        for(auto bb : func->bbs){
+            if(bb->insts.empty())
+                continue;
+            IRValue *term = bb->insts.back();
+            if(term->tag != IRValue::BRANCH || term->ops[0]->tag != IRValue::INTEGER)
+                continue;
+            int t = term->ops[0]->value ? 0 : 1;
+            toJump(term, term->target[t], term->getArgs(t));
+            changed = true;
+        }
+        removeUnreachable(func);
+
+        CFG cfg(func);
+        // 2. 空块：入口除外，沿着连续的空块找到最终的目标，br 的两个目标改写之后相同时不改
+        unordered_map<IRBasicBlock *, IRValue *> empty;
+        for(size_t b = 1; b < cfg.size(); ++b){
+            IRBasicBlock *bb = cfg.rpo[b];
+            IRValue *term = bb->insts.empty() ? nullptr : bb->insts.back();
+            if(bb->insts.size() == 1 && bb->params.empty() && term->tag == IRValue::JUMP && term->target[0] != bb)
+                empty[bb] = term;
+        }
+        auto forward = [&](IRBasicBlock *bb, vector<IRValue *> &args){
+            for(size_t steps = 0; empty.count(bb); ++steps){
+                if(steps == empty.size())
+                    return (IRBasicBlock *)nullptr;   // 空块构成的死循环
+                IRValue *jump = empty[bb];
+                bb = jump->target[0];
+                args = jump->ops;
+            }
+            return bb;
+        };
+        for(auto bb : func->bbs){
+            if(bb->insts.empty())
+                continue;
+            IRValue *term = bb->insts.back();
+            int k = term->tag == IRValue::BRANCH ? 2 : term->tag == IRValue::JUMP ? 1 : 0;
+            IRBasicBlock *to[2] = {nullptr, nullptr};
+            vector<IRValue *> args[2];
+            for(int t = 0; t < k; ++t){
+                args[t] = term->getArgs(t);
+                to[t] = forward(term->target[t], args[t]);
+            }
+            if(k == 2 && to[0] == to[1]){
+                // 两边最终到达同一个块、传的值也相同时不需要判断条件
+                if(to[0] != nullptr && args[0] == args[1]){
+                    toJump(term, to[0], args[0]);
+                    changed = true;
+                }
+                continue;
+            }
+            for(int t = 0; t < k; ++t){
+                if(to[t] == nullptr || to[t] == term->target[t])
+                    continue;
+                term->target[t] = to[t];
+                term->setArgs(t, args[t]);
+                changed = true;
+            }
+        }
+        if(changed)
+            continue;
+
+        // 3. 合并到唯一的前驱
+        unordered_map<IRValue *, IRValue *> replace;
+        vector<bool> merged(cfg.size(), false);
+        for(size_t b = 1; b < cfg.size(); ++b){
+            if(cfg.preds[b].size() != 1)
+                continue;
+            int p = cfg.preds[b][0];
+            IRBasicBlock *pred = cfg.rpo[p], *bb = cfg.rpo[b];
+            IRValue *jump = pred->insts.empty() ? nullptr : pred->insts.back();
+            if(jump == nullptr || jump->tag != IRValue::JUMP || merged[p] || p == (int)b)
+                continue;
+            for(size_t i = 0; i < bb->params.size(); ++i)
+                replace[bb->params[i]] = jump->ops[i];
+            pred->insts.pop_back();
+            for(auto v : bb->insts){
+                v->bb = pred;
+                pred->insts.push_back(v);
+            }
+            bb->insts.clear();
+            bb->params.clear();
+            merged[b] = true;
+            changed = true;
+        }
+        if(!changed)
+            break;
+        vector<IRBasicBlock *> bbs;
+        for(auto bb : func->bbs){
+            if(!bb->insts.empty())
+                bbs.push_back(bb);
+        }
+        func->bbs = bbs;
+        for(auto bb : func->bbs){
+            for(auto v : bb->insts){
+                for(auto &op : v->ops){
+                    auto it = replace.find(op);
+                    while(it != replace.end()){
+                        op = it->second;
+                        it = replace.find(op);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <charconv>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/*
+带缓冲区的文本输出
+内容先格式化到固定大小的缓冲区中，满了之后整块写入输出流，内存占用不随输出的大小增长
+整数用 std::to_chars 直接写进缓冲区，不产生临时字符串
+没有绑定输出流之前写入的内容会被丢弃
+*/
+class Emitter{
+private:
+    static const size_t CHUNK = 1 << 16;
+    std::ostream *os = nullptr;
+    size_t len = 0;
+    char buf[CHUNK];
+
+    // 保证缓冲区还有 n 个字节的空间，n 不超过 CHUNK
+    char *reserve(size_t n){
+        if(len + n > CHUNK)
+            flush();
+        return buf + len;
+    }
+public:
+    Emitter() = default;
+    explicit Emitter(std::ostream &_os): os(&_os){}
+    Emitter(const Emitter &) = delete;
+    Emitter &operator=(const Emitter &) = delete;
+    ~Emitter(){ flush(); }
+
+    void open(std::ostream &_os){
+        flush();
+        os = &_os;
+    }
+    void flush(){
+        if(os != nullptr && len != 0)
+            os->write(buf, len);
+        len = 0;
+    }
+
+    Emitter &operator<<(std::string_view s){
+        if(s.size() > CHUNK){
+            flush();
+            if(os != nullptr)
+                os->write(s.data(), s.size());
+            return *this;
+        }
+        std::memcpy(reserve(s.size()), s.data(), s.size());
+        len += s.size();
+        return *this;
+    }
+    Emitter &operator<<(const char *s){ return *this << std::string_view(s); }
+    Emitter &operator<<(const std::string &s){ return *this << std::string_view(s); }
+    Emitter &operator<<(char c){
+        *reserve(1) = c;
+        ++len;
+        return *this;
+    }
+    template<typename T, typename = std::enable_if_t<std::is_integral_v<T>
+        && !std::is_same_v<T, char> && !std::is_same_v<T, bool>>>
+    Emitter &operator<<(T v){
+        char *p = reserve(24);
+        len = std::to_chars(p, buf + CHUNK, v).ptr - buf;
+        return *this;
+    }
+
+    // n 个空格
+    Emitter &pad(size_t n){
+        while(n-- > 0)
+            *this << ' ';
+        return *this;
+    }
+};
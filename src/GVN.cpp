@@ -0,0 +1,145 @@
+#include "Pass.h"
+#include "CFG.h"
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+using namespace std;
+
+/*
+全局值编号（基于支配树的公共子表达式删除）
+1. 沿支配树先序遍历，表达式表随支配树分层：进入块时记下表的状态，离开时撤销，
+   表中的值都支配当前块，相同的二元运算、getelemptr/getptr 直接替换为表中的值
+   交换律运算的操作数按固定顺序比较，a > b 和 b < a 视为相同
+2. 冗余的 load 只在基本块内删除：记录每个地址当前的值，load 和 store 都会更新，
+   store 使可能指向同一位置的地址作废，call 使所有地址作废
+   基址是不同的 alloc/全局变量的地址不会重叠，其余的都视为可能重叠
+*/
+
+namespace {
+
+struct Expr{
+    int tag, op;
+    IRValue *a, *b;
+    bool operator==(const Expr &o) const {
+        return tag == o.tag && op == o.op && a == o.a && b == o.b;
+    }
+};
+
+struct ExprHash{
+    size_t operator()(const Expr &e) const {
+        size_t h = hash<IRValue *>()(e.a) * 31 + hash<IRValue *>()(e.b);
+        return h * 131 + e.tag * 17 + e.op;
+    }
+};
+
+}
+
+static bool commutative(IRValue::OP op){
+    switch(op){
+        case IRValue::OP_ADD: case IRValue::OP_MUL:
+        case IRValue::OP_AND: case IRValue::OP_OR: case IRValue::OP_XOR:
+        case IRValue::OP_EQ: case IRValue::OP_NOT_EQ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// 可以编号的指令对应的表达式
+static bool makeExpr(IRValue *v, Expr &e){
+    if(v->tag != IRValue::BINARY && v->tag != IRValue::GET_ELEM_PTR && v->tag != IRValue::GET_PTR)
+        return false;
+    e = Expr{v->tag, v->tag == IRValue::BINARY ? v->op : 0, v->ops[0], v->ops[1]};
+    if(v->tag != IRValue::BINARY)
+        return true;
+    // a > b 即 b < a，a >= b 即 b <= a
+    if(v->op == IRValue::OP_GT || v->op == IRValue::OP_GE){
+        e.op = v->op == IRValue::OP_GT ? IRValue::OP_LT : IRValue::OP_LE;
+        swap(e.a, e.b);
+    } else if(commutative(v->op) && less<IRValue *>()(e.b, e.a)){
+        swap(e.a, e.b);
+    }
+    return true;
+}
+
+static IRValue *resolve(const unordered_map<IRValue *, IRValue *> &replace, IRValue *v){
+    auto it = replace.find(v);
+    while(it != replace.end()){
+        v = it->second;
+        it = replace.find(v);
+    }
+    return v;
+}
+
+void gvn(IRFunction *func){
+    CFG cfg(func);
+    unordered_map<IRValue *, IRValue *> replace;
+    unordered_map<Expr, IRValue *, ExprHash> table;
+    vector<Expr> log;       // 按加入的顺序记录表中的表达式，离开块时撤销
+
+    // 显式栈模拟支配树上的 DFS：块编号，进入时 log 的长度，下一个要访问的孩子
+    struct Frame{
+        int b;
+        size_t mark, child;
+    };
+    vector<Frame> st{Frame{0, 0, 0}};
+    while(!st.empty()){
+        Frame &f = st.back();
+        if(f.child == 0){
+            f.mark = log.size();
+            IRBasicBlock *bb = cfg.rpo[f.b];
+            vector<pair<IRValue *, IRValue *>> mem;     // 地址 -> 当前的值
+            vector<IRValue *> insts;
+            for(auto v : bb->insts){
+                for(auto &op : v->ops)
+                    op = resolve(replace, op);
+                Expr e;
+                if(makeExpr(v, e)){
+                    auto it = table.find(e);
+                    if(it != table.end()){
+                        replace[v] = it->second;
+                        continue;
+                    }
+                    table.emplace(e, v);
+                    log.push_back(e);
+                } else if(v->tag == IRValue::LOAD){
+                    IRValue *addr = v->ops[0];
+                    auto it = find_if(mem.begin(), mem.end(), [&](auto &m){ return m.first == addr; });
+                    if(it != mem.end()){
+                        replace[v] = it->second;
+                        continue;
+                    }
+                    mem.emplace_back(addr, v);
+                } else if(v->tag == IRValue::STORE){
+                    IRValue *addr = v->ops[1];
+                    mem.erase(remove_if(mem.begin(), mem.end(), [&](auto &m){
+                        return mayAlias(m.first, addr);
+                    }), mem.end());
+                    mem.emplace_back(addr, v->ops[0]);
+                } else if(v->tag == IRValue::CALL){
+                    mem.clear();
+                }
+                insts.push_back(v);
+            }
+            bb->insts = insts;
+        }
+        if(f.child < cfg.children[f.b].size()){
+            int c = cfg.children[f.b][f.child++];
+            st.push_back(Frame{c, 0, 0});
+        } else {
+            while(log.size() > f.mark){
+                table.erase(log.back());
+                log.pop_back();
+            }
+            st.pop_back();
+        }
+    }
+
+    // 不可达的块中也可能用到被替换的值
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            for(auto &op : v->ops)
+                op = resolve(replace, op);
+        }
+    }
+}
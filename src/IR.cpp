@@ -0,0 +1,395 @@
+#include "IR.h"
+#include "Emitter.h"
+#include <cassert>
+#include <cstdint>
+using namespace std;
+
+// 所有类型全局唯一，创建后不释放
+static vector<unique_ptr<IRType>> type_pool;
+
+IRType *IRType::getInt32(){
+    static IRType *t = nullptr;
+    if(t == nullptr){
+        t = new IRType(INT32, 0, nullptr);
+        type_pool.emplace_back(t);
+    }
+    return t;
+}
+
+IRType *IRType::getUnit(){
+    static IRType *t = nullptr;
+    if(t == nullptr){
+        t = new IRType(UNIT, 0, nullptr);
+        type_pool.emplace_back(t);
+    }
+    return t;
+}
+
+IRType *IRType::getArray(IRType *base, size_t len){
+    for(auto &t : type_pool){
+        if(t->tag == ARRAY && t->base == base && t->len == len)
+            return t.get();
+    }
+    IRType *t = new IRType(ARRAY, len, base);
+    type_pool.emplace_back(t);
+    return t;
+}
+
+IRType *IRType::getPointer(IRType *base){
+    for(auto &t : type_pool){
+        if(t->tag == POINTER && t->base == base)
+            return t.get();
+    }
+    IRType *t = new IRType(POINTER, 0, base);
+    type_pool.emplace_back(t);
+    return t;
+}
+
+IRType *IRType::getFunction(const vector<IRType *> &params, IRType *ret){
+    for(auto &t : type_pool){
+        if(t->tag == FUNCTION && t->base == ret && t->params == params)
+            return t.get();
+    }
+    IRType *t = new IRType(FUNCTION, 0, ret);
+    t->params = params;
+    type_pool.emplace_back(t);
+    return t;
+}
+
+string IRType::str() const{
+    switch(tag){
+        case INT32:
+            return "i32";
+        case UNIT:
+            return "unit";
+        case ARRAY:
+            return "[" + base->str() + ", " + to_string(len) + "]";
+        case POINTER:
+            return "*" + base->str();
+        case FUNCTION: {
+            string s = "(";
+            for(size_t i = 0; i < params.size(); ++i){
+                if(i) s += ", ";
+                s += params[i]->str();
+            }
+            s += ")";
+            if(base->tag != UNIT)
+                s += ": " + base->str();
+            return s;
+        }
+    }
+    return "";
+}
+
+bool foldBinary(IRValue::OP op, int a, int b, int &res){
+    uint32_t ua = a, ub = b;
+    switch(op){
+        case IRValue::OP_NOT_EQ: res = a != b; break;
+        case IRValue::OP_EQ: res = a == b; break;
+        case IRValue::OP_GT: res = a > b; break;
+        case IRValue::OP_LT: res = a < b; break;
+        case IRValue::OP_GE: res = a >= b; break;
+        case IRValue::OP_LE: res = a <= b; break;
+        case IRValue::OP_ADD: res = (int)(ua + ub); break;
+        case IRValue::OP_SUB: res = (int)(ua - ub); break;
+        case IRValue::OP_MUL: res = (int)(ua * ub); break;
+        case IRValue::OP_DIV:
+            if(b == 0)
+                return false;
+            // INT_MIN / -1 溢出，RV32 的结果是 INT_MIN
+            res = b == -1 ? (int)(0u - ua) : a / b;
+            break;
+        case IRValue::OP_MOD:
+            if(b == 0)
+                return false;
+            res = b == -1 ? 0 : a % b;
+            break;
+        case IRValue::OP_AND: res = a & b; break;
+        case IRValue::OP_OR: res = a | b; break;
+        case IRValue::OP_XOR: res = a ^ b; break;
+        case IRValue::OP_SHL: res = (int)(ua << (ub & 31)); break;
+        case IRValue::OP_SHR: res = (int)(ua >> (ub & 31)); break;
+        case IRValue::OP_SAR: res = a >> (b & 31); break;
+    }
+    return true;
+}
+
+vector<IRValue *> IRValue::getArgs(int k) const{
+    if(tag == JUMP)
+        return ops;
+    if(k == 0)
+        return vector<IRValue *>(ops.begin() + 1, ops.begin() + 1 + true_args);
+    return vector<IRValue *>(ops.begin() + 1 + true_args, ops.end());
+}
+
+void IRValue::setArgs(int k, const vector<IRValue *> &args){
+    if(tag == JUMP){
+        ops = args;
+        return;
+    }
+    vector<IRValue *> t = getArgs(0), f = getArgs(1);
+    if(k == 0)
+        t = args;
+    else
+        f = args;
+    ops.resize(1);
+    ops.insert(ops.end(), t.begin(), t.end());
+    ops.insert(ops.end(), f.begin(), f.end());
+    true_args = t.size();
+}
+
+IRValue *IRFunction::newValue(IRValue::TAG tag, IRType *ty){
+    value_pool.emplace_back(new IRValue(tag, ty));
+    return value_pool.back().get();
+}
+
+IRBasicBlock *IRFunction::newBasicBlock(const string &name){
+    bb_pool.emplace_back(new IRBasicBlock(name));
+    return bb_pool.back().get();
+}
+
+size_t IRFunction::numberValues(){
+    int n = 0;
+    for(auto p : params)
+        p->id = n++;
+    for(auto bb : bbs){
+        for(auto p : bb->params)
+            p->id = n++;
+        for(auto v : bb->insts)
+            v->id = n++;
+    }
+    return n;
+}
+
+IRValue *IRProgram::newValue(IRValue::TAG tag, IRType *ty){
+    value_pool.emplace_back(new IRValue(tag, ty));
+    return value_pool.back().get();
+}
+
+IRValue *IRProgram::getInteger(int i){
+    auto it = ints.find(i);
+    if(it != ints.end())
+        return it->second;
+    IRValue *v = newValue(IRValue::INTEGER, IRType::getInt32());
+    v->value = i;
+    ints.insert(make_pair(i, v));
+    return v;
+}
+
+IRValue *IRProgram::getZeroInit(IRType *ty){
+    return newValue(IRValue::ZERO_INIT, ty);
+}
+
+IRFunction *IRProgram::newFunction(const string &name, IRType *ty){
+    func_pool.emplace_back(new IRFunction(name, ty));
+    funcs.push_back(func_pool.back().get());
+    return funcs.back();
+}
+
+// 输出时给临时值编号
+class ValueNamer{
+private:
+    unordered_map<const IRValue *, int> ids;
+    int cnt = 0;
+public:
+    void define(const IRValue *v){
+        if(v->name.empty())
+            ids[v] = cnt++;
+    }
+    void emit(Emitter &out, const IRValue *v) const{
+        switch(v->tag){
+            case IRValue::INTEGER:
+                out << v->value;
+                return;
+            case IRValue::ZERO_INIT:
+                out << "zeroinit";
+                return;
+            case IRValue::AGGREGATE:
+                out << '{';
+                for(size_t i = 0; i < v->ops.size(); ++i){
+                    if(i) out << ", ";
+                    emit(out, v->ops[i]);
+                }
+                out << '}';
+                return;
+            default:
+                break;
+        }
+        if(!v->name.empty()){
+            out << v->name;
+            return;
+        }
+        auto it = ids.find(v);
+        assert(it != ids.end());
+        out << '%' << it->second;
+    }
+};
+
+static const char *op_names[] = {
+    "ne", "eq", "gt", "lt", "ge", "le",
+    "add", "sub", "mul", "div", "mod",
+    "and", "or", "xor", "shl", "shr", "sar"
+};
+
+static void dumpTarget(Emitter &out, const ValueNamer &vn, const IRBasicBlock *bb, const IRValue *const *args, size_t n){
+    out << bb->name;
+    if(n){
+        out << '(';
+        for(size_t i = 0; i < n; ++i){
+            if(i) out << ", ";
+            vn.emit(out, args[i]);
+        }
+        out << ')';
+    }
+}
+
+// 两个操作数的指令
+static void dumpOps(Emitter &out, const ValueNamer &vn, const IRValue *v){
+    vn.emit(out, v->ops[0]);
+    out << ", ";
+    vn.emit(out, v->ops[1]);
+}
+
+static void dumpInst(Emitter &out, const ValueNamer &vn, const IRValue *v){
+    out << "  ";
+    if(v->hasResult()){
+        vn.emit(out, v);
+        out << " = ";
+    }
+    switch(v->tag){
+        case IRValue::ALLOC:
+            out << "alloc " << v->ty->base->str();
+            break;
+        case IRValue::LOAD:
+            out << "load ";
+            vn.emit(out, v->ops[0]);
+            break;
+        case IRValue::STORE:
+            out << "store ";
+            dumpOps(out, vn, v);
+            break;
+        case IRValue::GET_PTR:
+            out << "getptr ";
+            dumpOps(out, vn, v);
+            break;
+        case IRValue::GET_ELEM_PTR:
+            out << "getelemptr ";
+            dumpOps(out, vn, v);
+            break;
+        case IRValue::BINARY:
+            out << op_names[v->op] << ' ';
+            dumpOps(out, vn, v);
+            break;
+        case IRValue::BRANCH: {
+            const IRValue *const *args = v->ops.data() + 1;
+            size_t nf = v->ops.size() - 1 - v->true_args;
+            out << "br ";
+            vn.emit(out, v->ops[0]);
+            out << ", ";
+            dumpTarget(out, vn, v->target[0], args, v->true_args);
+            out << ", ";
+            dumpTarget(out, vn, v->target[1], args + v->true_args, nf);
+            break;
+        }
+        case IRValue::JUMP:
+            out << "jump ";
+            dumpTarget(out, vn, v->target[0], v->ops.data(), v->ops.size());
+            break;
+        case IRValue::CALL:
+            out << "call " << v->callee->name << '(';
+            for(size_t i = 0; i < v->ops.size(); ++i){
+                if(i) out << ", ";
+                vn.emit(out, v->ops[i]);
+            }
+            out << ')';
+            break;
+        case IRValue::RETURN:
+            out << "ret";
+            if(!v->ops.empty()){
+                out << ' ';
+                vn.emit(out, v->ops[0]);
+            }
+            break;
+        default:
+            assert(false);
+    }
+    out << '\n';
+}
+
+static void dumpFunction(Emitter &out, const IRFunction *func){
+    ValueNamer vn;
+    if(func->isDecl()){
+        out << "decl " << func->name << '(';
+        for(size_t i = 0; i < func->ty->params.size(); ++i){
+            if(i) out << ", ";
+            out << func->ty->params[i]->str();
+        }
+        out << ')';
+    } else {
+        // 先给所有临时值编号，使用可以出现在定义之前
+        for(auto p : func->params)
+            vn.define(p);
+        for(auto bb : func->bbs){
+            for(auto p : bb->params)
+                vn.define(p);
+            for(auto v : bb->insts){
+                if(v->hasResult())
+                    vn.define(v);
+            }
+        }
+        out << "fun " << func->name << '(';
+        for(size_t i = 0; i < func->params.size(); ++i){
+            if(i) out << ", ";
+            vn.emit(out, func->params[i]);
+            out << ": " << func->params[i]->ty->str();
+        }
+        out << ')';
+    }
+    if(func->ty->base->tag != IRType::UNIT)
+        out << ": " << func->ty->base->str();
+    if(func->isDecl()){
+        out << '\n';
+        return;
+    }
+    out << " {\n";
+    for(auto bb : func->bbs){
+        out << bb->name;
+        if(!bb->params.empty()){
+            out << '(';
+            for(size_t i = 0; i < bb->params.size(); ++i){
+                if(i) out << ", ";
+                vn.emit(out, bb->params[i]);
+                out << ": " << bb->params[i]->ty->str();
+            }
+            out << ')';
+        }
+        out << ":\n";
+        for(auto v : bb->insts)
+            dumpInst(out, vn, v);
+    }
+    out << "}\n\n";
+}
+
+void IRProgram::dump(ostream &os) const{
+    Emitter out(os);
+    ValueNamer vn;
+    for(auto v : values){
+        out << "global " << v->name << " = alloc " << v->ty->base->str() << ", ";
+        vn.emit(out, v->ops[0]);
+        out << '\n';
+    }
+    out << '\n';
+    bool decl = false;
+    for(auto f : funcs){
+        if(f->isDecl()){
+            dumpFunction(out, f);
+            decl = true;
+        }
+    }
+    if(decl)
+        out << '\n';
+    for(auto f : funcs){
+        if(!f->isDecl())
+            dumpFunction(out, f);
+    }
+}
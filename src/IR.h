@@ -0,0 +1,140 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+
+/*
+Koopa IR 的内存表示，结构上对应 koopa.h 中的 raw program，但可以直接修改
+IRType       类型：i32、unit、数组、指针、函数，全局唯一，可以直接比较指针
+IRValue      值：常量、参数、全局变量和指令，tag 区分种类，操作数统一放在 ops 中
+IRBasicBlock 基本块：块参数 + 指令序列
+IRFunction   函数：参数和基本块，持有函数内所有值和基本块的内存
+IRProgram    程序：全局变量和函数，持有全局值和整数常量的内存
+*/
+class IRType;
+class IRValue;
+class IRBasicBlock;
+class IRFunction;
+class IRProgram;
+
+class IRType{
+public:
+    enum TAG{ INT32, UNIT, ARRAY, POINTER, FUNCTION };
+    TAG tag;
+    size_t len;                     // 数组长度
+    IRType *base;                   // 数组元素 / 指针指向的类型 / 函数返回值类型
+    std::vector<IRType *> params;   // 函数参数类型
+
+    static IRType *getInt32();
+    static IRType *getUnit();
+    static IRType *getArray(IRType *base, size_t len);
+    static IRType *getPointer(IRType *base);
+    static IRType *getFunction(const std::vector<IRType *> &params, IRType *ret);
+
+    std::string str() const;        // 文本形式，如 i32、*i32、[i32, 3]
+private:
+    IRType(TAG _t, size_t _len, IRType *_base): tag(_t), len(_len), base(_base){}
+};
+
+class IRValue{
+public:
+    enum TAG{
+        INTEGER, ZERO_INIT, AGGREGATE, FUNC_ARG_REF, BLOCK_ARG_REF,
+        ALLOC, GLOBAL_ALLOC, LOAD, STORE, GET_PTR, GET_ELEM_PTR,
+        BINARY, BRANCH, JUMP, CALL, RETURN
+    };
+    // 顺序与 koopa_raw_binary_op_t 一致
+    enum OP{
+        OP_NOT_EQ, OP_EQ, OP_GT, OP_LT, OP_GE, OP_LE,
+        OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+        OP_AND, OP_OR, OP_XOR, OP_SHL, OP_SHR, OP_SAR
+    };
+    TAG tag;
+    IRType *ty;
+    std::string name;               // 具名值 (@x_0)，临时值为空，输出时按顺序编号
+    OP op;                          // BINARY 的运算符
+    int value;                      // INTEGER 的值，FUNC_ARG_REF / BLOCK_ARG_REF 的下标
+    /*
+    ops 中操作数的含义：
+        LOAD          src
+        STORE         value, dest
+        GET_PTR       src, index  (GET_ELEM_PTR 同)
+        BINARY        lhs, rhs
+        BRANCH        cond, true_args..., false_args...
+        JUMP          args...
+        CALL          args...
+        RETURN        [value]
+        GLOBAL_ALLOC  init
+        AGGREGATE     elems...
+    */
+    std::vector<IRValue *> ops;
+    IRBasicBlock *target[2];        // BRANCH 的 true/false 目标，JUMP 的目标为 target[0]
+    size_t true_args;               // BRANCH 中 true_args 的个数
+    IRFunction *callee;             // CALL 调用的函数
+    IRBasicBlock *bb;               // 指令所在的基本块
+    int id;                         // 在函数内的编号，见 IRFunction::numberValues，没有编号时为 -1
+
+    IRValue(TAG _t, IRType *_ty): tag(_t), ty(_ty), op(OP_ADD), value(0),
+        target{nullptr, nullptr}, true_args(0), callee(nullptr), bb(nullptr), id(-1){}
+
+    // 跳转到 target[k] 时传递的块参数
+    std::vector<IRValue *> getArgs(int k) const;
+    void setArgs(int k, const std::vector<IRValue *> &args);
+
+    bool isInst() const { return tag >= ALLOC && tag != GLOBAL_ALLOC; }
+    bool isTerminator() const { return tag == BRANCH || tag == JUMP || tag == RETURN; }
+    // 是否产生一个可被使用的值
+    bool hasResult() const { return ty->tag != IRType::UNIT; }
+};
+
+// 计算常量 a op b，按 32 位补码回绕，与 RV32 指令的结果一致
+// 除数为 0 时不折叠，返回 false，保留运行时的行为
+bool foldBinary(IRValue::OP op, int a, int b, int &res);
+
+class IRBasicBlock{
+public:
+    std::string name;               // 以 % 开头
+    std::vector<IRValue *> params;  // 块参数，都是 BLOCK_ARG_REF
+    std::vector<IRValue *> insts;
+    IRBasicBlock(const std::string &_name): name(_name){}
+};
+
+class IRFunction{
+public:
+    std::string name;               // 以 @ 开头
+    IRType *ty;                     // 函数类型
+    std::vector<IRValue *> params;  // FUNC_ARG_REF
+    std::vector<IRBasicBlock *> bbs;// 为空时表示函数声明，第一个块是入口
+
+    IRFunction(const std::string &_name, IRType *_ty): name(_name), ty(_ty){}
+    bool isDecl() const { return bbs.empty(); }
+
+    IRValue *newValue(IRValue::TAG tag, IRType *ty);
+    IRBasicBlock *newBasicBlock(const std::string &name);
+    // 给参数、块参数和指令从 0 开始连续编号，返回编号的个数
+    // 后端用编号代替哈希表索引每个值的信息，IR 修改之后要重新编号
+    size_t numberValues();
+private:
+    std::vector<std::unique_ptr<IRValue>> value_pool;
+    std::vector<std::unique_ptr<IRBasicBlock>> bb_pool;
+};
+
+class IRProgram{
+public:
+    std::vector<IRValue *> values;  // 全局变量，都是 GLOBAL_ALLOC
+    std::vector<IRFunction *> funcs;
+
+    IRValue *newValue(IRValue::TAG tag, IRType *ty);
+    IRValue *getInteger(int i);     // 整数常量在整个程序内共享
+    IRValue *getZeroInit(IRType *ty);
+    IRFunction *newFunction(const std::string &name, IRType *ty);
+
+    // 输出文本形式的 Koopa IR
+    void dump(std::ostream &os) const;
+private:
+    std::vector<std::unique_ptr<IRValue>> value_pool;
+    std::vector<std::unique_ptr<IRFunction>> func_pool;
+    std::unordered_map<int, IRValue *> ints;
+};
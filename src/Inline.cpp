@@ -0,0 +1,242 @@
+#include "Pass.h"
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+using namespace std;
+
+/*
+函数内联
+1. 不在调用环上（不直接或间接调用自己）的函数，指令数不超过 pass_options.inline_threshold，
+   或者整个程序中只有一处调用时，在调用处展开，调用者展开之后的大小不超过 MAX_CALLER
+2. 按调用图的后序处理，被调用的函数先完成内联，再被展开到调用者中
+3. 展开时把 call 所在的块在 call 处分成两半，前一半跳到复制出来的函数体的入口，
+   ret v 改为 jump 到后一半并把 v 作为块参数传过去，call 的结果替换为这个块参数
+   复制的值和块加上 _i<编号> 的后缀，保证名字在调用者中唯一
+4. 内联之后不再被调用的函数（main 除外）删除
+*/
+
+static const size_t MAX_CALLER = 4000;
+
+static size_t instCount(IRFunction *func){
+    size_t n = 0;
+    for(auto bb : func->bbs)
+        n += bb->insts.size();
+    return n;
+}
+
+// 在调用环上的函数
+static unordered_set<IRFunction *> recursive(const IRProgram &program){
+    unordered_map<IRFunction *, vector<IRFunction *>> callees;
+    for(auto func : program.funcs){
+        for(auto bb : func->bbs){
+            for(auto v : bb->insts){
+                if(v->tag == IRValue::CALL)
+                    callees[func].push_back(v->callee);
+            }
+        }
+    }
+    unordered_set<IRFunction *> res;
+    for(auto func : program.funcs){
+        // 从 func 出发能否回到 func
+        unordered_set<IRFunction *> seen;
+        vector<IRFunction *> work = callees[func];
+        while(!work.empty()){
+            IRFunction *f = work.back();
+            work.pop_back();
+            if(f == func){
+                res.insert(func);
+                break;
+            }
+            if(!seen.insert(f).second)
+                continue;
+            for(auto g : callees[f])
+                work.push_back(g);
+        }
+    }
+    return res;
+}
+
+// 把 callee 展开到 call 处，call 位于 caller 的 bb 中第 pos 条
+static void inlineCall(IRFunction *caller, IRBasicBlock *bb, size_t pos, int cnt){
+    IRValue *call = bb->insts[pos];
+    IRFunction *callee = call->callee;
+    string suffix = "_i" + to_string(cnt);
+
+    // call 之后的部分
+    IRBasicBlock *cont = caller->newBasicBlock(bb->name + "_cont" + to_string(cnt));
+    IRValue *result = nullptr;
+    if(call->hasResult()){
+        result = caller->newValue(IRValue::BLOCK_ARG_REF, call->ty);
+        result->value = 0;
+        result->bb = cont;
+        cont->params.push_back(result);
+    }
+    cont->insts.assign(bb->insts.begin() + pos + 1, bb->insts.end());
+    for(auto v : cont->insts)
+        v->bb = cont;
+    bb->insts.resize(pos);
+
+    // 复制函数体，参数直接替换为实参
+    unordered_map<IRValue *, IRValue *> vmap;
+    unordered_map<IRBasicBlock *, IRBasicBlock *> bmap;
+    for(size_t i = 0; i < callee->params.size(); ++i)
+        vmap[callee->params[i]] = call->ops[i];
+    vector<IRBasicBlock *> bbs;
+    for(auto cb : callee->bbs){
+        IRBasicBlock *nb = caller->newBasicBlock(cb->name + suffix);
+        bmap[cb] = nb;
+        bbs.push_back(nb);
+        for(auto p : cb->params){
+            IRValue *np = caller->newValue(p->tag, p->ty);
+            np->value = p->value;
+            np->name = p->name.empty() ? "" : p->name + suffix;
+            np->bb = nb;
+            nb->params.push_back(np);
+            vmap[p] = np;
+        }
+        for(auto v : cb->insts){
+            IRValue *nv;
+            if(v->tag == IRValue::RETURN){
+                // ret v => jump cont(v)
+                nv = caller->newValue(IRValue::JUMP, IRType::getUnit());
+                nv->ops = v->ops;
+                nv->target[0] = cont;
+            } else {
+                nv = caller->newValue(v->tag, v->ty);
+                *nv = *v;
+            }
+            nv->name = v->name.empty() ? "" : v->name + suffix;
+            nv->bb = nb;
+            nb->insts.push_back(nv);
+            vmap[v] = nv;
+        }
+    }
+    for(auto nb : bbs){
+        for(auto v : nb->insts){
+            for(auto &op : v->ops){
+                auto it = vmap.find(op);
+                if(it != vmap.end())
+                    op = it->second;
+            }
+            for(int t = 0; t < 2; ++t){
+                if(v->target[t] != nullptr && v->target[t] != cont)
+                    v->target[t] = bmap[v->target[t]];
+            }
+        }
+    }
+    // 没有返回值的函数，jump cont 不传参数
+    if(result == nullptr){
+        for(auto nb : bbs){
+            IRValue *term = nb->insts.back();
+            if(term->tag == IRValue::JUMP && term->target[0] == cont)
+                term->ops.clear();
+        }
+    }
+
+    IRValue *jump = caller->newValue(IRValue::JUMP, IRType::getUnit());
+    jump->target[0] = bbs[0];
+    jump->bb = bb;
+    bb->insts.push_back(jump);
+
+    auto it = find(caller->bbs.begin(), caller->bbs.end(), bb) + 1;
+    bbs.push_back(cont);
+    caller->bbs.insert(it, bbs.begin(), bbs.end());
+
+    if(result != nullptr){
+        for(auto b : caller->bbs){
+            for(auto v : b->insts){
+                for(auto &op : v->ops){
+                    if(op == call)
+                        op = result;
+                }
+            }
+        }
+    }
+}
+
+void inlineFunctions(IRProgram &program){
+    if(pass_options.inline_threshold <= 0)
+        return;
+    auto rec = recursive(program);
+    unordered_map<IRFunction *, int> sites;
+    for(auto func : program.funcs){
+        for(auto bb : func->bbs){
+            for(auto v : bb->insts){
+                if(v->tag == IRValue::CALL)
+                    ++sites[v->callee];
+            }
+        }
+    }
+
+    // 调用图的后序
+    vector<IRFunction *> order;
+    unordered_set<IRFunction *> seen;
+    for(auto root : program.funcs){
+        if(!seen.insert(root).second)
+            continue;
+        // 栈中记录函数和下一条要检查的调用
+        vector<pair<IRFunction *, vector<IRFunction *>>> st;
+        auto push = [&](IRFunction *f){
+            vector<IRFunction *> cs;
+            for(auto bb : f->bbs){
+                for(auto v : bb->insts){
+                    if(v->tag == IRValue::CALL)
+                        cs.push_back(v->callee);
+                }
+            }
+            reverse(cs.begin(), cs.end());
+            st.emplace_back(f, cs);
+        };
+        push(root);
+        while(!st.empty()){
+            auto &cs = st.back().second;
+            if(cs.empty()){
+                order.push_back(st.back().first);
+                st.pop_back();
+                continue;
+            }
+            IRFunction *f = cs.back();
+            cs.pop_back();
+            if(seen.insert(f).second)
+                push(f);
+        }
+    }
+
+    int cnt = 0;
+    for(auto caller : order){
+        if(caller->isDecl())
+            continue;
+        size_t size = instCount(caller);
+        // 展开之后新出现的 call 已经处理过，不再展开
+        for(size_t b = 0; b < caller->bbs.size(); ++b){
+            IRBasicBlock *bb = caller->bbs[b];
+            for(size_t i = 0; i < bb->insts.size(); ++i){
+                IRValue *v = bb->insts[i];
+                if(v->tag != IRValue::CALL)
+                    continue;
+                IRFunction *callee = v->callee;
+                if(callee->isDecl() || callee == caller || rec.count(callee))
+                    continue;
+                size_t n = instCount(callee);
+                if(n > (size_t)pass_options.inline_threshold && sites[callee] != 1)
+                    continue;
+                if(size + n > MAX_CALLER)
+                    continue;
+                inlineCall(caller, bb, i, cnt++);
+                --sites[callee];
+                size += n;
+                // bb 在 call 处结束，后一半和展开的函数体排在它后面，跳过函数体
+                b += callee->bbs.size();
+                break;
+            }
+        }
+    }
+
+    vector<IRFunction *> funcs;
+    for(auto func : program.funcs){
+        if(func->isDecl() || func->name == "@main" || sites[func] > 0)
+            funcs.push_back(func);
+    }
+    program.funcs = funcs;
+}
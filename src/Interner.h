@@ -0,0 +1,35 @@
+#pragma once
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Arena.h"
+
+/*
+标识符驻留表
+词法分析时把每个标识符映射成一个从 0 开始的整数 id，相同的文本得到相同的 id
+后端的符号表直接用 id 作下标，查找时不再需要哈希字符串
+文本保存在自己的 Arena 中，释放语法树之后仍然有效
+*/
+class Interner{
+private:
+    Arena text;
+    std::unordered_map<std::string_view, int> ids;
+    std::vector<const char *> strs;
+public:
+    int intern(const char *s, size_t n){
+        auto it = ids.find(std::string_view(s, n));
+        if(it != ids.end())
+            return it->second;
+        const char *p = text.strdup(s, n);
+        int id = strs.size();
+        strs.push_back(p);
+        ids.emplace(std::string_view(p, n), id);
+        return id;
+    }
+    int intern(std::string_view s){ return intern(s.data(), s.size()); }
+
+    const char *str(int id) const { return strs[id]; }
+    size_t size() const { return strs.size(); }
+};
+
+extern Interner idents;
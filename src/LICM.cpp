@@ -0,0 +1,114 @@
+#include "Pass.h"
+#include "CFG.h"
+#include <algorithm>
+#include <unordered_set>
+using namespace std;
+
+/*
+循环不变量外提
+内层循环先处理，每处理完一个循环重新分析控制流，外层循环能看到内层的 preheader 和外提出来的指令
+1. 操作数都在循环外定义（或已经外提）的二元运算、getelemptr/getptr 是不变量
+   while 循环可能一次都不执行，除法和取模只在除数是非 0 常量时外提
+2. load 的地址不变，循环中没有 call，也没有可能写到同一位置的 store 时外提，
+   地址必须是 alloc、全局变量或者常量下标的 getelemptr/getptr，循环不执行时读它也是安全的
+3. 不变量按原来的顺序放到 preheader 的末尾：header 在循环外只有一个以 jump 结尾的前驱时就是它，
+   否则新建一个块，参数和 header 相同，循环外的前驱都改为跳到它
+*/
+
+// 不执行也可以安全读取的地址
+static bool safeAddress(IRValue *addr){
+    while(addr->tag == IRValue::GET_ELEM_PTR || addr->tag == IRValue::GET_PTR){
+        if(addr->ops[1]->tag != IRValue::INTEGER)
+            return false;
+        addr = addr->ops[0];
+    }
+    return addr->tag == IRValue::ALLOC || addr->tag == IRValue::GLOBAL_ALLOC;
+}
+
+// 外提一个循环中的不变量
+static void hoist(IRFunction *func, const CFG &cfg, const Loop &loop){
+    unordered_set<IRValue *> inside;
+    vector<IRValue *> stores;
+    bool has_call = false;
+    for(int b : loop.blocks){
+        IRBasicBlock *bb = cfg.rpo[b];
+        for(auto p : bb->params)
+            inside.insert(p);
+        for(auto v : bb->insts){
+            inside.insert(v);
+            if(v->tag == IRValue::STORE)
+                stores.push_back(v->ops[1]);
+            has_call |= v->tag == IRValue::CALL;
+        }
+    }
+    auto invariant = [&](IRValue *v){
+        for(auto op : v->ops){
+            if(inside.count(op))
+                return false;
+        }
+        return true;
+    };
+
+    vector<IRValue *> hoisted;
+    for(int b : loop.blocks){
+        for(auto v : cfg.rpo[b]->insts){
+            bool ok = false;
+            switch(v->tag){
+                case IRValue::BINARY:
+                    ok = invariant(v);
+                    if(v->op == IRValue::OP_DIV || v->op == IRValue::OP_MOD)
+                        ok &= v->ops[1]->tag == IRValue::INTEGER && v->ops[1]->value != 0;
+                    break;
+                case IRValue::GET_ELEM_PTR:
+                case IRValue::GET_PTR:
+                    ok = invariant(v);
+                    break;
+                case IRValue::LOAD:
+                    ok = !has_call && invariant(v) && safeAddress(v->ops[0]);
+                    for(auto addr : stores)
+                        ok = ok && !mayAlias(addr, v->ops[0]);
+                    break;
+                default:
+                    break;
+            }
+            if(ok){
+                hoisted.push_back(v);
+                inside.erase(v);
+            }
+        }
+    }
+    if(hoisted.empty())
+        return;
+
+    unordered_set<IRValue *> moved(hoisted.begin(), hoisted.end());
+    for(int b : loop.blocks){
+        auto &insts = cfg.rpo[b]->insts;
+        insts.erase(remove_if(insts.begin(), insts.end(), [&](IRValue *v){
+            return moved.count(v) != 0;
+        }), insts.end());
+    }
+    IRBasicBlock *pre = preheader(func, cfg, loop);
+    IRValue *term = pre->insts.back();
+    pre->insts.pop_back();
+    for(auto v : hoisted){
+        v->bb = pre;
+        pre->insts.push_back(v);
+    }
+    pre->insts.push_back(term);
+}
+
+void licm(IRFunction *func){
+    unordered_set<IRBasicBlock *> done;
+    while(true){
+        CFG cfg(func);
+        auto loops = findLoops(cfg);
+        // 按 header 的逆后序排列，从后往前找就是内层循环先处理
+        auto it = find_if(loops.rbegin(), loops.rend(), [&](const Loop &loop){
+            return !done.count(cfg.rpo[loop.header]);
+        });
+        if(it == loops.rend())
+            break;
+        done.insert(cfg.rpo[it->header]);
+        hoist(func, cfg, *it);
+    }
+}
@@ -0,0 +1,166 @@
+#include "Pass.h"
+#include "CFG.h"
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+/*
+基本块布局
+1. 估计每条边的频率：块的频率按循环深度取 8^depth，
+   br 留在循环内的一侧占 9/10、离开循环的一侧占 1/10，其余情况两侧各占一半
+2. 按频率从高到低把边连成链：边的起点是一条链的尾、终点是另一条链的头时接成一条链，入口只能是链头
+   回边不参与连接，否则 header 接在 latch 后面，进入循环的边就不能落空了
+3. 入口所在的链放在最前面，之后每次选已放置的块连过去的边中频率最高的链，
+   频率相同时按链头原来的顺序，这样循环内的链排在一起，循环的出口排在循环体之后
+4. 循环旋转：循环占据连续的一段、header 在最前面、最后一块 jump 回 header、
+   header 的 br 离开循环的一侧正好是循环后面的块时，把 header 挪到最后，
+   每次迭代少执行一条 j，代价是进入循环时多一条 j
+5. 不可达的块放在最后
+跳到下一个块的 jump 和 br 的一侧在生成 RISC-V 时不再需要 j
+*/
+
+struct Edge{
+    int from, to;
+    double weight;
+};
+
+// from -> to 是否离开了 from 所在的某个循环
+static bool exitsLoop(const vector<Loop> &loops, int from, int to){
+    for(auto &loop : loops){
+        if(loop.contains(from) && !loop.contains(to))
+            return true;
+    }
+    return false;
+}
+
+// 内层循环先旋转，外层循环的检查用旋转之后的顺序
+static void rotateLoops(const CFG &cfg, const vector<Loop> &loops, vector<int> &layout){
+    for(auto it = loops.rbegin(); it != loops.rend(); ++it){
+        const Loop &loop = *it;
+        size_t p = find(layout.begin(), layout.end(), loop.header) - layout.begin();
+        size_t k = loop.blocks.size();
+        if(p + k > layout.size() || k < 2)
+            continue;
+        bool contiguous = true;
+        for(size_t i = p; i < p + k; ++i)
+            contiguous &= loop.contains(layout[i]);
+        if(!contiguous)
+            continue;
+        int last = layout[p + k - 1];
+        auto &hs = cfg.succs[loop.header];
+        if(cfg.succs[last].size() != 1 || cfg.succs[last][0] != loop.header || hs.size() != 2)
+            continue;
+        int exit = loop.contains(hs[0]) ? hs[1] : hs[0];
+        if(loop.contains(exit) || p + k >= layout.size() || layout[p + k] != exit)
+            continue;
+        rotate(layout.begin() + p, layout.begin() + p + 1, layout.begin() + p + k);
+    }
+}
+
+void layoutBlocks(IRFunction *func){
+    CFG cfg(func);
+    size_t n = cfg.size();
+    auto loops = findLoops(cfg);
+    auto depth = loopDepth(cfg, loops);
+
+    vector<Edge> edges;
+    for(size_t b = 0; b < n; ++b){
+        double freq = pow(8.0, min(depth[b], 8));
+        auto &succs = cfg.succs[b];
+        if(succs.size() == 1){
+            edges.push_back(Edge{(int)b, succs[0], freq});
+        } else if(succs.size() == 2 && succs[0] != succs[1]){
+            bool exit0 = exitsLoop(loops, b, succs[0]);
+            bool exit1 = exitsLoop(loops, b, succs[1]);
+            double p = exit0 == exit1 ? 0.5 : exit0 ? 0.1 : 0.9;
+            edges.push_back(Edge{(int)b, succs[0], freq * p});
+            edges.push_back(Edge{(int)b, succs[1], freq * (1 - p)});
+        }
+    }
+    // 权重相同时保持原来的顺序，true 分支优先
+    stable_sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b){
+        return a.weight > b.weight;
+    });
+
+    vector<vector<int>> chains(n);
+    vector<int> chain_of(n);
+    for(size_t b = 0; b < n; ++b){
+        chains[b].push_back(b);
+        chain_of[b] = b;
+    }
+    for(auto &e : edges){
+        int ca = chain_of[e.from], cb = chain_of[e.to];
+        if(e.to == 0 || cfg.dominates(e.to, e.from) || ca == cb || chains[ca].back() != e.from || chains[cb].front() != e.to)
+            continue;
+        for(int b : chains[cb]){
+            chains[ca].push_back(b);
+            chain_of[b] = ca;
+        }
+        chains[cb].clear();
+    }
+
+    // 链头原来的位置
+    unordered_map<IRBasicBlock *, int> pos;
+    for(size_t i = 0; i < func->bbs.size(); ++i)
+        pos[func->bbs[i]] = i;
+    // 从入口所在的链开始，每次接上已放置的块连过去的边中频率最高的链，都没有时取原来位置最前的链
+    vector<int> order{chain_of[0]};
+    vector<bool> placed(n, false);
+    placed[chain_of[0]] = true;
+    vector<double> score(n, -1);
+    auto place = [&](int c){
+        for(auto &e : edges){
+            if(chain_of[e.from] == c && !placed[chain_of[e.to]])
+                score[chain_of[e.to]] = max(score[chain_of[e.to]], e.weight);
+        }
+    };
+    place(chain_of[0]);
+    while(true){
+        int best = -1;
+        for(size_t c = 0; c < n; ++c){
+            if(chains[c].empty() || placed[c])
+                continue;
+            if(best < 0 || score[c] > score[best]
+                || (score[c] == score[best] && pos[cfg.rpo[chains[c].front()]] < pos[cfg.rpo[chains[best].front()]]))
+                best = c;
+        }
+        if(best < 0)
+            break;
+        order.push_back(best);
+        placed[best] = true;
+        place(best);
+    }
+
+    vector<int> layout;
+    for(int c : order){
+        for(int b : chains[c])
+            layout.push_back(b);
+    }
+    rotateLoops(cfg, loops, layout);
+
+    vector<IRBasicBlock *> bbs;
+    for(int b : layout)
+        bbs.push_back(cfg.rpo[b]);
+    for(auto bb : func->bbs){
+        if(!cfg.reachable(bb))
+            bbs.push_back(bb);
+    }
+    func->bbs = bbs;
+
+    if(pass_options.layout_dump != nullptr){
+        ostream &os = *pass_options.layout_dump;
+        size_t fall = 0;
+        for(size_t i = 0; i + 1 < bbs.size(); ++i){
+            for(auto s : CFG::successors(bbs[i])){
+                if(s == bbs[i + 1]){
+                    ++fall;
+                    break;
+                }
+            }
+        }
+        os << "layout " << func->name << ":";
+        for(auto bb : bbs)
+            os << " " << bb->name << "(" << (cfg.reachable(bb) ? depth[cfg.index[bb]] : 0) << ")";
+        os << "\n  " << fall << " of " << edges.size() << " edges fall through\n";
+    }
+}
@@ -0,0 +1,226 @@
+#include "Pass.h"
+#include "CFG.h"
+#include <unordered_map>
+using namespace std;
+
+/*
+mem2reg：Cytron 等人的 SSA 构造算法
+1. 找出可以提升的 alloc：i32 类型，只作为 load 的地址和 store 的目标，没有被取地址
+2. 在 store 所在块的迭代支配边界上插入块参数
+3. 沿支配树重命名：load 替换为当前值，store 更新当前值，跳转时把当前值作为块参数传过去
+4. 删除没有被真正使用的块参数
+*/
+
+// 可以提升的 alloc，按出现顺序编号
+static unordered_map<IRValue *, int> findPromotable(IRFunction *func){
+    unordered_map<IRValue *, bool> ok;
+    vector<IRValue *> allocs;
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            if(v->tag == IRValue::ALLOC && v->ty->base == IRType::getInt32()){
+                ok[v] = true;
+                allocs.push_back(v);
+            }
+        }
+    }
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            for(size_t i = 0; i < v->ops.size(); ++i){
+                IRValue *op = v->ops[i];
+                if(op->tag != IRValue::ALLOC)
+                    continue;
+                bool direct = v->tag == IRValue::LOAD || (v->tag == IRValue::STORE && i == 1);
+                if(!direct)
+                    ok[op] = false;
+            }
+        }
+    }
+    unordered_map<IRValue *, int> id;
+    for(auto a : allocs){
+        if(ok[a]){
+            int k = id.size();
+            id[a] = k;
+        }
+    }
+    return id;
+}
+
+static IRValue *resolve(const unordered_map<IRValue *, IRValue *> &replace, IRValue *v){
+    auto it = replace.find(v);
+    while(it != replace.end()){
+        v = it->second;
+        it = replace.find(v);
+    }
+    return v;
+}
+
+// 删除新增的块参数中没有被使用，或者只被传给其他无用块参数的
+static void removeDeadParams(IRFunction *func, const vector<IRValue *> &params){
+    unordered_map<IRValue *, bool> used;
+    for(auto p : params)
+        used[p] = false;
+    vector<IRValue *> work;
+    auto use = [&](IRValue *v){
+        auto it = used.find(v);
+        if(it != used.end() && !it->second){
+            it->second = true;
+            work.push_back(v);
+        }
+    };
+    // 每个块的所有入边 (terminator, target 下标)
+    unordered_map<IRBasicBlock *, vector<pair<IRValue *, int>>> in_edges;
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            if(v->tag == IRValue::BRANCH){
+                in_edges[v->target[0]].emplace_back(v, 0);
+                in_edges[v->target[1]].emplace_back(v, 1);
+                use(v->ops[0]);
+            } else if(v->tag == IRValue::JUMP){
+                in_edges[v->target[0]].emplace_back(v, 0);
+            } else {
+                for(auto op : v->ops)
+                    use(op);
+            }
+        }
+        // 原有的块参数都视为被使用
+        for(auto p : bb->params){
+            if(!used.count(p))
+                work.push_back(p);
+        }
+    }
+    // 被使用的块参数，传给它的值也被使用
+    while(!work.empty()){
+        IRValue *p = work.back();
+        work.pop_back();
+        for(auto &e : in_edges[p->bb])
+            use(e.first->getArgs(e.second)[p->value]);
+    }
+
+    unordered_set<IRValue *> dead;
+    for(auto &kv : used){
+        if(!kv.second)
+            dead.insert(kv.first);
+    }
+    removeBlockParams(func, dead);
+}
+
+void mem2reg(IRProgram &program, IRFunction *func){
+    // 不可达的块不在支配树上，先删掉
+    removeUnreachable(func);
+    auto id = findPromotable(func);
+    if(id.empty())
+        return;
+    CFG cfg(func);
+    size_t n = cfg.size(), m = id.size();
+
+    // 在迭代支配边界上放置块参数
+    vector<vector<int>> def_blocks(m);
+    for(size_t b = 0; b < n; ++b){
+        for(auto v : cfg.rpo[b]->insts){
+            if(v->tag == IRValue::STORE && id.count(v->ops[1])){
+                auto &d = def_blocks[id[v->ops[1]]];
+                if(d.empty() || d.back() != (int)b)
+                    d.push_back(b);
+            }
+        }
+    }
+    vector<vector<int>> param_alloc(n);     // 每个块新增的块参数对应的 alloc
+    vector<IRValue *> new_params;
+    vector<int> has_param(n, -1), in_work(n, -1);
+    for(size_t a = 0; a < m; ++a){
+        vector<int> work = def_blocks[a];
+        for(int b : work)
+            in_work[b] = a;
+        while(!work.empty()){
+            int b = work.back();
+            work.pop_back();
+            for(int d : cfg.df[b]){
+                if(has_param[d] == (int)a)
+                    continue;
+                has_param[d] = a;
+                IRBasicBlock *bb = cfg.rpo[d];
+                IRValue *p = func->newValue(IRValue::BLOCK_ARG_REF, IRType::getInt32());
+                p->value = bb->params.size();
+                p->bb = bb;
+                bb->params.push_back(p);
+                param_alloc[d].push_back(a);
+                new_params.push_back(p);
+                if(in_work[d] != (int)a){
+                    in_work[d] = a;
+                    work.push_back(d);
+                }
+            }
+        }
+    }
+
+    // 沿支配树重命名，未初始化的变量取 0
+    unordered_map<IRValue *, IRValue *> replace;
+    vector<vector<IRValue *>> cur(m, vector<IRValue *>{program.getInteger(0)});
+    // 栈上记录进入块时压入的 alloc，离开时弹出
+    vector<pair<int, vector<int>>> st;
+    st.emplace_back(0, vector<int>());
+    vector<size_t> child_pos(n, 0);
+    bool entering = true;
+    while(!st.empty()){
+        int b = st.back().first;
+        if(entering){
+            IRBasicBlock *bb = cfg.rpo[b];
+            auto &pushed = st.back().second;
+            size_t first = bb->params.size() - param_alloc[b].size();
+            for(size_t i = 0; i < param_alloc[b].size(); ++i){
+                int a = param_alloc[b][i];
+                cur[a].push_back(bb->params[first + i]);
+                pushed.push_back(a);
+            }
+            vector<IRValue *> insts;
+            for(auto v : bb->insts){
+                if(v->tag == IRValue::ALLOC && id.count(v))
+                    continue;
+                if(v->tag == IRValue::LOAD && id.count(v->ops[0])){
+                    replace[v] = cur[id[v->ops[0]]].back();
+                    continue;
+                }
+                if(v->tag == IRValue::STORE && id.count(v->ops[1])){
+                    int a = id[v->ops[1]];
+                    cur[a].push_back(resolve(replace, v->ops[0]));
+                    pushed.push_back(a);
+                    continue;
+                }
+                insts.push_back(v);
+            }
+            bb->insts = insts;
+            // 给后继新增的块参数传值
+            if(!insts.empty()){
+                IRValue *term = insts.back();
+                int k = term->tag == IRValue::BRANCH ? 2 : term->tag == IRValue::JUMP ? 1 : 0;
+                for(int t = 0; t < k; ++t){
+                    int s = cfg.index[term->target[t]];
+                    if(param_alloc[s].empty())
+                        continue;
+                    vector<IRValue *> args = term->getArgs(t);
+                    for(int a : param_alloc[s])
+                        args.push_back(cur[a].back());
+                    term->setArgs(t, args);
+                }
+            }
+        }
+        if(child_pos[b] < cfg.children[b].size()){
+            int c = cfg.children[b][child_pos[b]++];
+            st.emplace_back(c, vector<int>());
+            entering = true;
+        } else {
+            for(int a : st.back().second)
+                cur[a].pop_back();
+            st.pop_back();
+            entering = false;
+        }
+    }
+
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            for(auto &op : v->ops)
+                op = resolve(replace, op);
+        }
+    }
+    removeDeadParams(func, new_params);
+}
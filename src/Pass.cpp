@@ -0,0 +1,43 @@
+#include "Pass.h"
+using namespace std;
+
+PassOptions pass_options;
+
+void optimize(IRProgram &program){
+    // 先把每个函数化简成 SSA 形式，内联时按化简后的大小判断
+    for(auto func : program.funcs){
+        if(func->isDecl())
+            continue;
+        mem2reg(program, func);
+        constFold(program, func);
+        // 尾递归改成循环之后不再递归，可以被内联
+        tailRecursion(func);
+    }
+    inlineFunctions(program);
+    for(auto func : program.funcs){
+        if(func->isDecl())
+            continue;
+        // 内联之后常量实参传进了函数体
+        constFold(program, func);
+        gvn(func);
+        dce(func);
+        simplifyCFG(func);
+        // 化简之后 br 的条件可能不再被使用
+        dce(func);
+        licm(func);
+        // 新建的 preheader 的块参数折叠成传入的常量，展开时才能算出常量的循环次数
+        bool changed = strengthReduce(program, func);
+        if(changed)
+            constFold(program, func);
+        // 展开出的副本中有新的常量运算，同一块中的运算和 load 可以合并
+        changed |= unrollLoops(program, func);
+        if(changed){
+            constFold(program, func);
+            gvn(func);
+            dce(func);
+            simplifyCFG(func);
+            dce(func);
+        }
+        layoutBlocks(func);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <ostream>
+#include "IR.h"
+
+/*
+IR 上的优化，在生成 Koopa IR 之后、输出或生成 RISC-V 之前运行
+每个 pass 处理一个函数，直接修改 IR，需要整数常量时从 program 中取
+*/
+
+// 把只被 load/store 访问的 i32 局部变量提升为 SSA 值，合流处使用块参数
+void mem2reg(IRProgram &program, IRFunction *func);
+
+// mem2reg 之后折叠常量运算，删除只收到同一个值的块参数
+void constFold(IRProgram &program, IRFunction *func);
+
+// 把调用自己的尾调用改为跳回函数开头的循环
+void tailRecursion(IRFunction *func);
+
+// 把小函数和只有一处调用的函数展开到调用处，处理整个程序
+void inlineFunctions(IRProgram &program);
+
+// 全局值编号：删除被支配的相同运算和地址计算，以及基本块内冗余的 load
+void gvn(IRFunction *func);
+
+// 删除结果没有被用到的指令、没有被用到的块参数和写到从不被读取的局部变量的 store
+void dce(IRFunction *func);
+
+// 化简控制流：常量条件的 br 改为 jump，跳过空块，合并只有一个前驱的块，删除不可达的块
+void simplifyCFG(IRFunction *func);
+
+// 把循环中不变的运算、地址计算和没有被写入的 load 外提到循环的 preheader
+void licm(IRFunction *func);
+
+// 归纳变量强度削减：循环中按下标线性变化的地址和含有乘法的导出值改为每次迭代累加
+// 有改动时返回 true
+bool strengthReduce(IRProgram &program, IRFunction *func);
+
+// 展开最内层的计数循环：常量次数的小循环完全展开，其余按 pass_options.unroll_factor 展开并保留余数循环
+// 有改动时返回 true，之后需要再做常量折叠和化简
+bool unrollLoops(IRProgram &program, IRFunction *func);
+
+// 按估计的边频率重排基本块，让频繁的边成为落空，循环体连续
+void layoutBlocks(IRFunction *func);
+
+// 优化选项，由 main 根据命令行设置
+struct PassOptions{
+    std::ostream *layout_dump = nullptr;    // 不为空时输出每个函数的块布局
+    int inline_threshold = 40;              // 内联的函数最多的指令数，不大于 0 时不内联
+    int unroll_factor = 4;                  // 循环展开的份数，不大于 1 时不展开
+};
+extern PassOptions pass_options;
+
+// 对整个程序依次运行各个 pass
+void optimize(IRProgram &program);
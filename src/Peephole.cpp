@@ -0,0 +1,222 @@
+#include "Peephole.h"
+#include <climits>
+#include <utility>
+using namespace std;
+
+static bool immediate(int i){ return -2048 <= i && i < 2048; }
+
+// 代码生成用的临时寄存器，只在相邻的几条指令内有效
+static bool isScratch(const string &r){
+    return r == "t0" || r == "t1" || r == "t2" || r == "t3";
+}
+
+void Peephole::remove(size_t i, RULE rule){
+    dead[i] = true;
+    ++removed[rule];
+}
+
+void Peephole::run(vector<RiscvInst> &insts){
+    bool (Peephole::*rules[])(vector<RiscvInst> &) = {
+        &Peephole::forwardLoads, &Peephole::removeMoves,
+        &Peephole::selectImmediates, &Peephole::removeJumps
+    };
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(auto rule : rules){
+            dead.assign(insts.size(), false);
+            if(!(this->*rule)(insts))
+                continue;
+            changed = true;
+            size_t k = 0;
+            for(size_t i = 0; i < insts.size(); ++i){
+                if(dead[i])
+                    continue;
+                if(k != i)
+                    insts[k] = std::move(insts[i]);
+                ++k;
+            }
+            insts.erase(insts.begin() + k, insts.end());
+        }
+    }
+}
+
+// 在一个基本块内记录每个栈槽当前的值在哪个寄存器里
+// 写其他地址的 sw 可能写到栈上，call 和标号处全部作废
+bool Peephole::forwardLoads(vector<RiscvInst> &insts){
+    bool changed = false;
+    vector<pair<int, string>> slots;   // 栈槽偏移 -> 保存着它的值的寄存器
+    auto kill = [&](const RiscvInst &v){
+        for(size_t k = 0; k < slots.size(); ){
+            if(v.writesReg(slots[k].second)){
+                slots[k] = slots.back();
+                slots.pop_back();
+            } else {
+                ++k;
+            }
+        }
+    };
+    auto find = [&](int offset) -> pair<int, string> *{
+        for(auto &s : slots)
+            if(s.first == offset) return &s;
+        return nullptr;
+    };
+    for(size_t i = 0; i < insts.size(); ++i){
+        RiscvInst &v = insts[i];
+        if(v.kind == RiscvInst::LABEL || v.kind == RiscvInst::TEXT || v.kind == RiscvInst::CALL
+            || v.kind == RiscvInst::TAIL || (v.kind == RiscvInst::SW && v.rs1 != "sp") || v.writesReg("sp")){
+            slots.clear();
+            continue;
+        }
+        if(v.kind == RiscvInst::LW && v.rs1 == "sp"){
+            auto s = find(v.imm);
+            if(s != nullptr){
+                if(s->second == v.rd){
+                    remove(i, FORWARD);
+                } else {
+                    // lw rd, off(sp) => mv rd, r
+                    v.kind = RiscvInst::MV;
+                    v.rs1 = s->second;
+                    ++removed[FORWARD];
+                    kill(v);
+                }
+                changed = true;
+                continue;
+            }
+            kill(v);
+            slots.emplace_back(v.imm, v.rd);
+            continue;
+        }
+        if(v.kind == RiscvInst::SW && v.rs1 == "sp"){
+            auto s = find(v.imm);
+            if(s != nullptr)
+                s->second = v.rs2;
+            else
+                slots.emplace_back(v.imm, v.rs2);
+            continue;
+        }
+        kill(v);
+    }
+    return changed;
+}
+
+bool Peephole::removeMoves(vector<RiscvInst> &insts){
+    bool changed = false;
+    RiscvInst *prev = nullptr;
+    for(size_t i = 0; i < insts.size(); ++i){
+        RiscvInst &v = insts[i];
+        // 和 x0 运算的结果就是另一个操作数
+        if(v.kind == RiscvInst::RR && (v.op == "add" || v.op == "or" || v.op == "xor" || v.op == "sub")){
+            if(v.rs2 == "x0"){
+                v.kind = RiscvInst::MV;
+            } else if(v.rs1 == "x0" && v.op != "sub"){
+                v.kind = RiscvInst::MV;
+                v.rs1 = v.rs2;
+            }
+        }
+        if(v.kind == RiscvInst::MV && (v.rd == v.rs1
+            || (prev != nullptr && prev->kind == RiscvInst::MV && prev->rd == v.rs1 && prev->rs1 == v.rd))){
+            remove(i, MOVE);
+            changed = true;
+            continue;
+        }
+        prev = &v;
+    }
+    return changed;
+}
+
+// 由 RR 指令和常量所在的位置得到对应的 RI 指令，不能转换时返回 nullptr
+static const char *immediateForm(const string &op, bool lhs, int &imm){
+    if(op == "add") return "addi";
+    if(op == "and") return "andi";
+    if(op == "or") return "ori";
+    if(op == "xor") return "xori";
+    if(lhs){
+        // sgt rd, C, rs 即 slt rd, rs, C
+        return op == "sgt" ? "slti" : nullptr;
+    }
+    if(op == "sub"){
+        if(imm == INT_MIN)
+            return nullptr;
+        imm = -imm;
+        return "addi";
+    }
+    if(op == "slt") return "slti";
+    if(op == "sll" || op == "srl" || op == "sra"){
+        if(imm < 0 || imm >= 32)
+            return nullptr;
+        return op == "sll" ? "slli" : op == "srl" ? "srli" : "srai";
+    }
+    return nullptr;
+}
+
+bool Peephole::selectImmediates(vector<RiscvInst> &insts){
+    bool changed = false;
+    size_t n = insts.size();
+    for(size_t i = 0; i < n; ++i){
+        const RiscvInst &v = insts[i];
+        if(v.kind != RiscvInst::LI || !isScratch(v.rd))
+            continue;
+        const string &r = v.rd;
+        // 找到第一条使用 r 的指令
+        size_t j = i + 1;
+        while(j < n && !insts[j].isBarrier() && !insts[j].readsReg(r) && !insts[j].writesReg(r))
+            ++j;
+        if(j == n || !insts[j].readsReg(r))
+            continue;
+        RiscvInst &u = insts[j];
+        if(u.kind != RiscvInst::RR || (u.rs1 == r && u.rs2 == r))
+            continue;
+        bool lhs = u.rs1 == r;
+        int imm = v.imm;
+        const char *op = immediateForm(u.op, lhs, imm);
+        if(op == nullptr || !immediate(imm))
+            continue;
+        // r 之后不能再被使用
+        bool used = false;
+        if(!u.writesReg(r)){
+            for(size_t k = j + 1; k < n && !insts[k].isBarrier(); ++k){
+                if(insts[k].readsReg(r)){
+                    used = true;
+                    break;
+                }
+                if(insts[k].writesReg(r))
+                    break;
+            }
+        }
+        if(used)
+            continue;
+        u.kind = RiscvInst::RI;
+        u.op = op;
+        u.rs1 = lhs ? u.rs2 : u.rs1;
+        u.rs2.clear();
+        u.imm = imm;
+        remove(i, IMMEDIATE);
+        changed = true;
+    }
+    return changed;
+}
+
+bool Peephole::removeJumps(vector<RiscvInst> &insts){
+    bool changed = false;
+    for(size_t i = 0; i < insts.size(); ++i){
+        const RiscvInst &v = insts[i];
+        if(v.kind != RiscvInst::J && v.kind != RiscvInst::BZ && v.kind != RiscvInst::BR)
+            continue;
+        for(size_t k = i + 1; k < insts.size() && insts[k].kind == RiscvInst::LABEL; ++k){
+            if(insts[k].sym == v.sym){
+                remove(i, JUMP);
+                changed = true;
+                break;
+            }
+        }
+    }
+    return changed;
+}
+
+void Peephole::report(ostream &os) const{
+    os << "peephole: forwarded loads " << removed[FORWARD]
+       << ", redundant moves " << removed[MOVE]
+       << ", immediate forms " << removed[IMMEDIATE]
+       << ", jumps to next " << removed[JUMP] << "\n";
+}
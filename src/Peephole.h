@@ -0,0 +1,30 @@
+#pragma once
+#include <ostream>
+#include <vector>
+#include "RiscvInst.h"
+
+/*
+对一个函数的汇编做窥孔优化，反复应用下面的规则直到不再变化
+1. store 到 load 的转发：同一个栈槽刚写入或读出过，后面的 lw 换成 mv 或直接删除
+2. 删除多余的 mv：mv a, a，以及紧跟在 mv a, b 后面的 mv b, a；和 x0 的 add/sub/or/xor 变成 mv
+3. 立即数指令选择：li 到临时寄存器之后只被一条 add/sub/and/or/xor/slt/sgt/移位使用时，合并成 addi/slti/xori 等
+4. 删除跳到下一条的 j 和条件分支
+t0-t3 是代码生成用的临时寄存器，不会跨越基本块，规则 3 依赖这一点
+*/
+class Peephole{
+public:
+    enum RULE{ FORWARD, MOVE, IMMEDIATE, JUMP, RULE_CNT };
+    size_t removed[RULE_CNT] = {};     // 每条规则删除的指令数
+
+    void run(std::vector<RiscvInst> &insts);
+    void report(std::ostream &os) const;
+
+private:
+    std::vector<bool> dead;
+
+    bool forwardLoads(std::vector<RiscvInst> &insts);
+    bool removeMoves(std::vector<RiscvInst> &insts);
+    bool selectImmediates(std::vector<RiscvInst> &insts);
+    bool removeJumps(std::vector<RiscvInst> &insts);
+    void remove(size_t i, RULE rule);
+};
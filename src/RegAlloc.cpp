@@ -0,0 +1,278 @@
+#include "RegAlloc.h"
+#include "CFG.h"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+using namespace std;
+
+// 可分配的寄存器，前 CALLER_CNT 个是 caller-saved，后面的是 callee-saved
+const char *RegisterAllocator::names[] = {
+    "t4", "t5", "t6",
+    "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7",
+    "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11"
+};
+static const int CALLER_CNT = 11;
+static const int REG_CNT = 23;
+static const int A0 = 3;
+
+// 活跃变量分析用的位集合
+class BitSet{
+private:
+    vector<uint64_t> bits;
+public:
+    explicit BitSet(size_t n = 0): bits((n + 63) / 64, 0){}
+    void set(size_t i){ bits[i >> 6] |= 1ull << (i & 63); }
+    void reset(size_t i){ bits[i >> 6] &= ~(1ull << (i & 63)); }
+    bool test(size_t i) const { return bits[i >> 6] >> (i & 63) & 1; }
+    // this |= o，返回是否有变化
+    bool merge(const BitSet &o){
+        bool changed = false;
+        for(size_t i = 0; i < bits.size(); ++i){
+            uint64_t b = bits[i] | o.bits[i];
+            changed |= b != bits[i];
+            bits[i] = b;
+        }
+        return changed;
+    }
+    template<typename F>
+    void forEach(F f) const {
+        for(size_t i = 0; i < bits.size(); ++i){
+            uint64_t b = bits[i];
+            while(b){
+                int k = __builtin_ctzll(b);
+                f(i * 64 + k);
+                b &= b - 1;
+            }
+        }
+    }
+};
+
+// 需要分配寄存器的值
+static bool isVReg(IRValue *v){
+    switch(v->tag){
+        case IRValue::FUNC_ARG_REF:
+        case IRValue::BLOCK_ARG_REF:
+            return true;
+        case IRValue::ALLOC:
+            return false;
+        default:
+            return v->isInst() && v->hasResult();
+    }
+}
+
+// 对 v 使用的每个值调用 f，folded 中的值换成它的操作数
+template<typename F>
+static void forEachUse(const RegisterAllocator &ra, IRValue *v, F f){
+    for(auto op : v->ops){
+        if(ra.isFolded(op))
+            forEachUse(ra, op, f);
+        else
+            f(op);
+    }
+}
+
+void RegisterAllocator::run(IRFunction *func, size_t n){
+    reg.assign(n, SPILLED);
+    callee_used.clear();
+    spills.clear();
+    vector<Interval> intervals;
+    buildIntervals(func, n, intervals);
+    linearScan(intervals);
+}
+
+void RegisterAllocator::buildIntervals(IRFunction *func, size_t values, vector<Interval> &intervals){
+    // 需要分配的值在 intervals 中的下标，按值的编号索引
+    vector<int> id(values, -1);
+    auto addVReg = [&](IRValue *v, int hint){
+        id[v->id] = intervals.size();
+        intervals.push_back(Interval{v, INT32_MAX, -1, hint, false});
+    };
+    for(size_t i = 0; i < func->params.size(); ++i)
+        addVReg(func->params[i], i < 8 ? A0 + (int)i : -1);
+    for(auto bb : func->bbs){
+        for(auto p : bb->params)
+            addVReg(p, -1);
+        for(auto v : bb->insts){
+            if(isVReg(v) && !isFolded(v))
+                addVReg(v, -1);
+        }
+    }
+    size_t n = intervals.size();
+
+    // 按块在汇编中的顺序给指令线性编号，块参数在块开始处定义
+    // 布局把循环旋转之后 header 排在循环体后面，编号时把它挪回循环的最前面，
+    // 否则循环传递的块参数的区间和循环体中新算出的值重叠，寄存器压力加倍
+    // 同时求每个块的 use（在块内定义之前被使用）和 def
+    unordered_map<IRBasicBlock *, int> bb_id;
+    vector<IRBasicBlock *> order = func->bbs;
+    CFG cfg(func);
+    for(auto &loop : findLoops(cfg)){
+        IRBasicBlock *header = cfg.rpo[loop.header];
+        auto h = find(order.begin(), order.end(), header);
+        auto first = find_if(order.begin(), order.end(), [&](IRBasicBlock *bb){
+            return cfg.reachable(bb) && loop.contains(cfg.index.at(bb));
+        });
+        if(first < h)
+            rotate(first, h, h + 1);
+    }
+    for(size_t i = 0; i < order.size(); ++i)
+        bb_id[order[i]] = i;
+    size_t m = order.size();
+    vector<int> bb_start(m), bb_end(m);
+    vector<BitSet> use(m, BitSet(n)), def(m, BitSet(n));
+    vector<int> calls;
+    int pos = 0;
+    for(size_t b = 0; b < m; ++b){
+        IRBasicBlock *bb = order[b];
+        bb_start[b] = pos;
+        if(b == 0){
+            for(auto p : func->params){
+                int k = id[p->id];
+                intervals[k].start = pos;
+                def[b].set(k);
+            }
+        }
+        for(auto p : bb->params){
+            int k = id[p->id];
+            intervals[k].start = pos;
+            def[b].set(k);
+        }
+        for(auto v : bb->insts){
+            if(isFolded(v))
+                continue;
+            pos += 2;
+            forEachUse(*this, v, [&](IRValue *op){
+                int k = op->id >= 0 ? id[op->id] : -1;
+                if(k < 0)
+                    return;
+                if(!def[b].test(k))
+                    use[b].set(k);
+                intervals[k].end = max(intervals[k].end, pos);
+            });
+            if(v->tag == IRValue::CALL)
+                calls.push_back(pos);
+            int k = id[v->id];
+            if(k >= 0){
+                intervals[k].start = pos;
+                intervals[k].end = max(intervals[k].end, pos);
+                def[b].set(k);
+            }
+        }
+        bb_end[b] = pos;
+        pos += 2;
+    }
+
+    // 活跃变量分析：live_in = use ∪ (live_out - def)，live_out = ∪ live_in(succ)
+    vector<BitSet> live_in(m, BitSet(n)), live_out(m, BitSet(n));
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(size_t b = m; b-- > 0; ){
+            IRBasicBlock *bb = order[b];
+            if(!bb->insts.empty()){
+                IRValue *term = bb->insts.back();
+                int succ = term->tag == IRValue::BRANCH ? 2 : term->tag == IRValue::JUMP ? 1 : 0;
+                for(int s = 0; s < succ; ++s)
+                    changed |= live_out[b].merge(live_in[bb_id[term->target[s]]]);
+            }
+            BitSet in = live_out[b];
+            def[b].forEach([&](size_t k){ in.reset(k); });
+            in.merge(use[b]);
+            changed |= live_in[b].merge(in);
+        }
+    }
+
+    // 活跃区间用一整段表示，覆盖所有活跃的块
+    // 出口活跃的值要活过 terminator，不能和在 terminator 处写入的块参数共用寄存器
+    auto cover = [&](size_t k, int p){
+        intervals[k].start = min(intervals[k].start, p);
+        intervals[k].end = max(intervals[k].end, p);
+    };
+    for(size_t b = 0; b < m; ++b){
+        live_in[b].forEach([&](size_t k){ cover(k, bb_start[b]); });
+        live_out[b].forEach([&](size_t k){ cover(k, bb_end[b] + 1); });
+        // 块参数在前驱的 terminator 处被赋值
+        IRBasicBlock *bb = order[b];
+        if(bb->insts.empty())
+            continue;
+        IRValue *term = bb->insts.back();
+        int succ = term->tag == IRValue::BRANCH ? 2 : term->tag == IRValue::JUMP ? 1 : 0;
+        for(int s = 0; s < succ; ++s){
+            for(auto p : term->target[s]->params)
+                cover(id[p->id], bb_end[b]);
+        }
+    }
+    for(auto &it : intervals){
+        // 没有被使用的值
+        if(it.end < it.start)
+            it.end = it.start;
+        auto c = upper_bound(calls.begin(), calls.end(), it.start);
+        it.cross_call = c != calls.end() && *c < it.end;
+    }
+}
+
+void RegisterAllocator::linearScan(vector<Interval> &intervals){
+    sort(intervals.begin(), intervals.end(), [](const Interval &a, const Interval &b){
+        return a.start < b.start;
+    });
+    vector<Interval *> active;
+    bool busy[REG_CNT] = {};
+
+    for(auto &cur : intervals){
+        // 释放已经结束的区间，结束位置等于当前定义位置时寄存器可以复用
+        for(size_t i = 0; i < active.size(); ){
+            if(active[i]->end <= cur.start){
+                busy[reg[active[i]->value->id]] = false;
+                active[i] = active.back();
+                active.pop_back();
+            } else {
+                ++i;
+            }
+        }
+        // 跨越 call 的只能用 callee-saved 寄存器
+        int lo = cur.cross_call ? CALLER_CNT : 0;
+        int r = -1;
+        if(cur.hint >= lo && !busy[cur.hint]){
+            r = cur.hint;
+        } else {
+            for(int i = lo; i < REG_CNT; ++i){
+                if(!busy[i]){
+                    r = i;
+                    break;
+                }
+            }
+        }
+        if(r >= 0){
+            busy[r] = true;
+            reg[cur.value->id] = r;
+            active.push_back(&cur);
+            continue;
+        }
+        // 没有空闲寄存器，溢出结束最晚的区间
+        Interval *victim = nullptr;
+        for(auto a : active){
+            if(reg[a->value->id] >= lo && (victim == nullptr || a->end > victim->end))
+                victim = a;
+        }
+        if(victim != nullptr && victim->end > cur.end){
+            reg[cur.value->id] = reg[victim->value->id];
+            reg[victim->value->id] = SPILLED;
+            *find(active.begin(), active.end(), victim) = &cur;
+        } else {
+            reg[cur.value->id] = SPILLED;
+        }
+    }
+
+    bool used[REG_CNT] = {};
+    for(auto &cur : intervals){
+        int r = reg[cur.value->id];
+        if(r != SPILLED)
+            used[r] = true;
+        else
+            spills.push_back(Range{cur.value, cur.start, cur.end});
+    }
+    for(int i = CALLER_CNT; i < REG_CNT; ++i){
+        if(used[i])
+            callee_used.push_back(names[i]);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "IR.h"
+
+/*
+线性扫描寄存器分配
+每个有结果的值（指令结果、函数参数、块参数）对应一个活跃区间 [start, end]，
+位置为指令在函数中的线性编号，区间由基本块的活跃变量分析得到
+跨越 call 的区间只能放在 callee-saved 的 s 寄存器中，其余优先使用 t/a 寄存器
+寄存器不够时溢出结束最晚的区间，溢出的值由 LocalVarAllocator 分配栈上的位置，
+区间不重叠的溢出值共用同一个栈槽
+t0 ~ t3 不参与分配，留给后端生成代码时临时使用
+*/
+class RegisterAllocator{
+public:
+    static constexpr int SPILLED = -1;
+
+    // 在使用处展开计算、不需要寄存器的值：常量下标的 getelemptr 等地址，以及合并到 br 中的比较，
+    // 按值的编号索引，由后端在 run 之前设置，使用它们的指令视为直接使用它们的操作数
+    std::vector<bool> folded;
+
+    // 溢出的值和它的活跃区间，按区间开始的位置排序
+    struct Range{
+        IRValue *value;
+        int start, end;
+    };
+    std::vector<Range> spills;
+
+    // 函数中的值已经用 numberValues 编号，n 为值的个数
+    void run(IRFunction *func, size_t n);
+
+    bool isFolded(IRValue *v) const {
+        return v->id >= 0 && folded[v->id];
+    }
+    // 值是否分配到了寄存器
+    bool inReg(IRValue *v) const {
+        return v->id >= 0 && reg[v->id] != SPILLED;
+    }
+    // 值所在的寄存器名
+    const char *getReg(IRValue *v) const {
+        return names[reg[v->id]];
+    }
+    // 使用到的 callee-saved 寄存器，需要在 prologue/epilogue 保存恢复
+    const std::vector<const char *> &usedCalleeSaved() const {
+        return callee_used;
+    }
+
+private:
+    struct Interval{
+        IRValue *value;
+        int start, end;
+        int hint;           // 倾向的寄存器，函数参数为对应的 a 寄存器
+        bool cross_call;    // 区间内有 call
+    };
+    static const char *names[];
+    std::vector<int> reg;       // 值的编号 -> names 中的下标，或 SPILLED
+    std::vector<const char *> callee_used;
+
+    void buildIntervals(IRFunction *func, size_t n, std::vector<Interval> &intervals);
+    void linearScan(std::vector<Interval> &intervals);
+};
@@ -0,0 +1,54 @@
+#include "RiscvInst.h"
+#include <unordered_map>
+using namespace std;
+
+// B 型指令的偏移范围
+static bool inRange(int delta){
+    return -4096 <= delta && delta <= 4094;
+}
+
+int relaxBranches(vector<RiscvInst> &insts, const string &prefix, int &cnt){
+    int relaxed = 0;
+    bool changed = true;
+    while(changed){
+        changed = false;
+        vector<int> offset(insts.size());
+        unordered_map<string, int> labels;
+        int pc = 0;
+        for(size_t i = 0; i < insts.size(); ++i){
+            offset[i] = pc;
+            if(insts[i].kind == RiscvInst::LABEL)
+                labels[insts[i].sym] = pc;
+            pc += insts[i].size();
+        }
+        vector<RiscvInst> out;
+        out.reserve(insts.size());
+        for(size_t i = 0; i < insts.size(); ++i){
+            RiscvInst &v = insts[i];
+            if(v.kind != RiscvInst::BZ && v.kind != RiscvInst::BR){
+                out.push_back(std::move(v));
+                continue;
+            }
+            auto it = labels.find(v.sym);
+            if(it == labels.end() || inRange(it->second - offset[i])){
+                out.push_back(std::move(v));
+                continue;
+            }
+            string target = v.sym;
+            string skip = prefix + to_string(cnt++);
+            v.op = invertBranch(v.op);
+            v.sym = skip;
+            out.push_back(std::move(v));
+            RiscvInst j(RiscvInst::J);
+            j.sym = target;
+            out.push_back(std::move(j));
+            RiscvInst l(RiscvInst::LABEL);
+            l.sym = skip;
+            out.push_back(std::move(l));
+            ++relaxed;
+            changed = true;
+        }
+        insts.swap(out);
+    }
+    return relaxed;
+}
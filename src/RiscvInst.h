@@ -0,0 +1,103 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/*
+一条 RISC-V 汇编，RiscvString 先把一个函数的汇编记成 RiscvInst 的列表，做完窥孔优化再输出
+寄存器和 RISC-V 的写法一致：lw rd, imm(rs1)，sw rs2, imm(rs1)
+*/
+struct RiscvInst{
+    enum KIND{
+        LABEL,      // sym:
+        TEXT,       // 伪指令等原样输出的文本 sym
+        RR,         // op rd, rs1, rs2
+        RI,         // op rd, rs1, imm
+        R,          // op rd, rs1，如 seqz/snez
+        MV,         // mv rd, rs1
+        LI,         // li rd, imm
+        LA,         // la rd, sym
+        LW,         // lw rd, imm(rs1)
+        SW,         // sw rs2, imm(rs1)
+        BZ,         // op rs1, sym，如 bnez/beqz
+        BR,         // op rs1, rs2, sym，如 blt/bge
+        J,          // j sym
+        CALL,       // call sym
+        TAIL,       // tail sym，尾调用，不返回到这里
+        RET         // ret
+    };
+    KIND kind;
+    std::string op;
+    std::string rd, rs1, rs2;
+    int imm = 0;
+    std::string sym;
+
+    explicit RiscvInst(KIND _kind): kind(_kind){}
+
+    // 是否读取寄存器 r，call 和 ret 按调用约定读取参数和返回值寄存器
+    bool readsReg(const std::string &r) const{
+        switch(kind){
+            case RR: case BR: case SW:
+                return rs1 == r || rs2 == r;
+            case RI: case R: case MV: case LW: case BZ:
+                return rs1 == r;
+            case CALL:
+                return r.size() == 2 && r[0] == 'a' && r[1] <= '7';
+            case TAIL:
+                return (r.size() == 2 && r[0] == 'a' && r[1] <= '7') || r == "ra";
+            case RET:
+                return r == "a0" || r == "ra";
+            default:
+                return false;
+        }
+    }
+    // 是否写入寄存器 r，call 之后所有 caller-saved 寄存器都视为被改写
+    bool writesReg(const std::string &r) const{
+        switch(kind){
+            case RR: case RI: case R: case MV: case LI: case LA: case LW:
+                return rd == r;
+            case CALL:
+                return r == "ra" || r[0] == 't' || (r[0] == 'a' && r.size() == 2);
+            default:
+                return false;
+        }
+    }
+    // 汇编后的字节数，li 超出 12 位立即数时按 lui + addi 算，la、call 和 tail 展开为两条指令
+    int size() const{
+        switch(kind){
+            case LABEL: case TEXT:
+                return 0;
+            case LI:
+                return -2048 <= imm && imm < 2048 ? 4 : 8;
+            case LA: case CALL: case TAIL:
+                return 8;
+            default:
+                return 4;
+        }
+    }
+    // 基本块的边界：标号和控制流转移
+    bool isBarrier() const{
+        return kind == LABEL || kind == TEXT || kind == BZ || kind == BR
+            || kind == J || kind == CALL || kind == TAIL || kind == RET;
+    }
+};
+
+// 条件取反的分支指令，不认识的返回 nullptr
+inline const char *invertBranch(const std::string &op){
+    static const char *pairs[][2] = {
+        {"beqz", "bnez"}, {"beq", "bne"}, {"blt", "bge"}, {"bgt", "ble"},
+        {"bltu", "bgeu"}, {"bgtu", "bleu"}
+    };
+    for(auto &p : pairs){
+        if(op == p[0]) return p[1];
+        if(op == p[1]) return p[0];
+    }
+    return nullptr;
+}
+
+/*
+分支松弛
+条件分支只能跳到 ±4KB 以内，先按目标直接生成，输出前估算每条指令的偏移，
+超出范围的 b cond, L 改写为 b !cond, skip; j L; skip:，改写会让代码变长，反复进行直到都在范围内
+新标号为 prefix 加上 cnt 的编号，返回改写的分支数
+*/
+int relaxBranches(std::vector<RiscvInst> &insts, const std::string &prefix, int &cnt);
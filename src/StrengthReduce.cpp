@@ -0,0 +1,275 @@
+#include "Pass.h"
+#include "CFG.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+using namespace std;
+
+/*
+归纳变量强度削减
+内层循环先处理，每处理完一个循环重新分析控制流
+1. 基本归纳变量：header 的块参数 i，所有回边传给它的都是 i 加上同一个常量 s
+2. 循环中由 i 线性导出的值 a * i + b，a 是常量或循环外定义的值，b 是循环外定义的值：
+   i + b、i - 常量、i * a、i << 常量，以及 a * i 再加上 b
+3. 下标是这样的值、基址在循环外定义的 getelemptr/getptr 改为 header 上新的指针参数，
+   preheader 中算出第一次的地址，每条回边上 getptr p, a * s 得到下一次的地址，
+   以 br 结尾的回边上插入一个只有 jump 的块放这条 getptr
+   含有乘法的导出值被其他运算使用时同样改为新的参数，每条回边上加 a * s
+原来的运算不再被使用，由之后的 dce 删除
+*/
+
+static int nexts = 0;       // 回边上插入的块的后缀编号，在整个程序内唯一
+
+namespace {
+
+// a * iv + b，b 为空时表示 0
+struct Affine{
+    IRValue *iv;
+    IRValue *a, *b;
+};
+
+}
+
+static bool isInt(IRValue *v, int k){
+    return v->tag == IRValue::INTEGER && v->value == k;
+}
+
+static IRValue *newBinary(IRFunction *func, IRValue::OP op, IRValue *x, IRValue *y){
+    IRValue *v = func->newValue(IRValue::BINARY, IRType::getInt32());
+    v->op = op;
+    v->ops = {x, y};
+    return v;
+}
+
+// 在 bb 的结尾（跳转之前）插入 v
+static IRValue *insertBefore(IRBasicBlock *bb, IRValue *v){
+    v->bb = bb;
+    bb->insts.insert(bb->insts.end() - 1, v);
+    return v;
+}
+
+// 整数运算按 32 位补码回绕
+static IRValue *mulConst(IRProgram &program, int x, int y){
+    return program.getInteger((int)((unsigned)x * (unsigned)y));
+}
+
+// 一个循环的强度削减，有改动时返回 true
+static bool reduce(IRProgram &program, IRFunction *func, const CFG &cfg, const Loop &loop){
+    IRBasicBlock *header = cfg.rpo[loop.header];
+    unordered_set<IRValue *> inside;
+    for(int b : loop.blocks){
+        for(auto p : cfg.rpo[b]->params)
+            inside.insert(p);
+        for(auto v : cfg.rpo[b]->insts)
+            inside.insert(v);
+    }
+    auto invariant = [&](IRValue *v){ return !inside.count(v); };
+
+    // 回边：块和跳到 header 的一边
+    vector<pair<IRBasicBlock *, int>> edges;
+    for(int l : loop.latches){
+        IRValue *term = cfg.rpo[l]->insts.back();
+        for(int t = 0; t < 2; ++t){
+            if(term->target[t] == header)
+                edges.emplace_back(cfg.rpo[l], t);
+        }
+    }
+
+    // 基本归纳变量和它们的步长
+    unordered_map<IRValue *, int> steps;
+    unordered_map<IRValue *, Affine> affine;
+    for(size_t k = 0; k < header->params.size(); ++k){
+        IRValue *p = header->params[k];
+        bool ok = true, first = true;
+        int step = 0;
+        for(auto &e : edges){
+            int s;
+            ok &= stepOf(e.first->insts.back()->getArgs(e.second)[k], p, s) && (first || s == step);
+            step = s;
+            first = false;
+        }
+        if(ok && step != 0){
+            steps[p] = step;
+            affine[p] = Affine{p, program.getInteger(1), nullptr};
+        }
+    }
+    if(steps.empty())
+        return false;
+
+    // 按逆后序找出导出的值，操作数的定义都在使用之前
+    vector<IRValue *> derived, addrs;
+    for(int b : loop.blocks){
+        for(auto v : cfg.rpo[b]->insts){
+            if(v->tag == IRValue::GET_ELEM_PTR || v->tag == IRValue::GET_PTR){
+                if(invariant(v->ops[0]) && affine.count(v->ops[1]))
+                    addrs.push_back(v);
+                continue;
+            }
+            if(v->tag != IRValue::BINARY)
+                continue;
+            IRValue *x = v->ops[0], *y = v->ops[1];
+            bool commute = v->op == IRValue::OP_ADD || v->op == IRValue::OP_MUL;
+            if(commute && !affine.count(x))
+                swap(x, y);
+            auto it = affine.find(x);
+            if(it == affine.end() || !invariant(y))
+                continue;
+            Affine f = it->second;
+            bool ok = true;
+            switch(v->op){
+                case IRValue::OP_ADD:
+                    ok = f.b == nullptr;
+                    f.b = y;
+                    break;
+                case IRValue::OP_SUB:
+                    ok = f.b == nullptr && y->tag == IRValue::INTEGER && y->value != INT32_MIN;
+                    if(ok)
+                        f.b = program.getInteger(-y->value);
+                    break;
+                case IRValue::OP_MUL:
+                    ok = f.b == nullptr && (isInt(f.a, 1) || (f.a->tag == IRValue::INTEGER && y->tag == IRValue::INTEGER));
+                    if(ok)
+                        f.a = isInt(f.a, 1) ? y : mulConst(program, f.a->value, y->value);
+                    break;
+                case IRValue::OP_SHL:
+                    ok = f.b == nullptr && f.a->tag == IRValue::INTEGER && y->tag == IRValue::INTEGER
+                        && y->value >= 0 && y->value < 32;
+                    if(ok)
+                        f.a = mulConst(program, f.a->value, (int)(1u << y->value));
+                    break;
+                default:
+                    ok = false;
+                    break;
+            }
+            if(ok){
+                affine[v] = f;
+                derived.push_back(v);
+            }
+        }
+    }
+
+    // 含有乘法的导出值，被线性运算和要削减的地址的下标以外的指令使用时才需要削减
+    unordered_set<IRValue *> reduced(addrs.begin(), addrs.end());
+    unordered_set<IRValue *> needed;
+    for(auto bb : func->bbs){
+        for(auto u : bb->insts){
+            if(affine.count(u))
+                continue;
+            for(size_t i = 0; i < u->ops.size(); ++i){
+                IRValue *op = u->ops[i];
+                auto it = affine.find(op);
+                if(it != affine.end() && !isInt(it->second.a, 1) && !(reduced.count(u) && i == 1))
+                    needed.insert(op);
+            }
+        }
+    }
+    vector<IRValue *> targets;
+    for(auto v : derived){
+        if(needed.count(v))
+            targets.push_back(v);
+    }
+    targets.insert(targets.end(), addrs.begin(), addrs.end());
+    if(targets.empty())
+        return false;
+
+    // 以 br 结尾的回边上插入一个块，更新只在回到 header 时计算
+    for(auto &e : edges){
+        IRValue *br = e.first->insts.back();
+        if(br->tag != IRValue::BRANCH)
+            continue;
+        IRBasicBlock *bb = func->newBasicBlock(e.first->name + "_next" + to_string(nexts++));
+        IRValue *jump = func->newValue(IRValue::JUMP, IRType::getUnit());
+        jump->ops = br->getArgs(e.second);
+        jump->target[0] = header;
+        jump->bb = bb;
+        bb->insts.push_back(jump);
+        br->setArgs(e.second, {});
+        br->target[e.second] = bb;
+        func->bbs.insert(find(func->bbs.begin(), func->bbs.end(), e.first) + 1, bb);
+        e = make_pair(bb, 0);
+    }
+    IRBasicBlock *pre = preheader(func, cfg, loop);
+    IRValue *entry = pre->insts.back();
+    unordered_map<IRValue *, IRValue *> replace;
+    for(auto v : targets){
+        bool addr = v->tag != IRValue::BINARY;
+        Affine f = affine[addr ? v->ops[1] : v];
+        size_t k = f.iv->value;
+        int s = steps[f.iv];
+
+        // 第一次的值 a * i0 + b
+        IRValue *init = entry->ops[k];
+        if(init->tag == IRValue::INTEGER && f.a->tag == IRValue::INTEGER)
+            init = mulConst(program, init->value, f.a->value);
+        else if(!isInt(f.a, 1) && !isInt(init, 0))
+            init = insertBefore(pre, newBinary(func, IRValue::OP_MUL, init, f.a));
+        if(f.b != nullptr)
+            init = isInt(init, 0) ? f.b : insertBefore(pre, newBinary(func, IRValue::OP_ADD, init, f.b));
+        if(addr){
+            IRValue *p = func->newValue(v->tag, v->ty);
+            p->ops = {v->ops[0], init};
+            init = insertBefore(pre, p);
+        }
+        // 每次增加 a * s
+        IRValue *inc;
+        if(f.a->tag == IRValue::INTEGER)
+            inc = mulConst(program, f.a->value, s);
+        else if(s == 1)
+            inc = f.a;
+        else
+            inc = insertBefore(pre, newBinary(func, IRValue::OP_MUL, f.a, program.getInteger(s)));
+
+        IRValue *param = func->newValue(IRValue::BLOCK_ARG_REF, v->ty);
+        param->value = header->params.size();
+        param->bb = header;
+        header->params.push_back(param);
+        entry->ops.push_back(init);
+        for(auto &e : edges){
+            IRValue *next;
+            if(addr){
+                next = func->newValue(IRValue::GET_PTR, v->ty);
+                next->ops = {param, inc};
+            } else {
+                next = newBinary(func, IRValue::OP_ADD, param, inc);
+            }
+            insertBefore(e.first, next);
+            IRValue *term = e.first->insts.back();
+            vector<IRValue *> args = term->getArgs(e.second);
+            args.push_back(next);
+            term->setArgs(e.second, args);
+        }
+        replace[v] = param;
+    }
+
+    // 新的参数和原来的值在每次进入 header 时都相等，header 之后的使用都可以替换
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            for(auto &op : v->ops){
+                auto it = replace.find(op);
+                if(it != replace.end())
+                    op = it->second;
+            }
+        }
+    }
+    return true;
+}
+
+bool strengthReduce(IRProgram &program, IRFunction *func){
+    unordered_set<IRBasicBlock *> done;
+    bool changed = false;
+    while(true){
+        CFG cfg(func);
+        auto loops = findLoops(cfg);
+        // 按 header 的逆后序排列，从后往前找就是内层循环先处理
+        auto it = find_if(loops.rbegin(), loops.rend(), [&](const Loop &loop){
+            return !done.count(cfg.rpo[loop.header]);
+        });
+        if(it == loops.rend())
+            break;
+        done.insert(cfg.rpo[it->header]);
+        changed |= reduce(program, func, cfg, *it);
+    }
+    return changed;
+}
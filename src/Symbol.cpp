@@ -2,6 +2,8 @@
 #include "Symbol.h"
 using namespace std;
 
+Interner idents;    // 标识符驻留表
+
 void NameTable::reset(){  // name map的初始化
     cnt = 0;
 }
@@ -48,74 +50,31 @@ SysYType::~SysYType() {
 }
 
 // 构造函数：使用标识符 _ident、名称 _name 和类型指针 _t 初始化 Symbol
-Symbol::Symbol(const std::string &_ident, const std::string &_name, SysYType *_t): ident(_ident), name(_name), ty(_t){
+Symbol::Symbol(int _ident, const std::string &_name, SysYType *_t): ident(_ident), name(_name), ty(_t){
 }
 
 Symbol::~Symbol(){
     if(ty) delete ty;
 }
 
-STable::~STable(){
-    for(auto &p : symbol_tb){
-        delete p.second; 
-    } 
-}
-// 插入符号表
-void STable::insert(Symbol *symbol){
-    symbol_tb.insert({symbol->ident, symbol});
-} 
-// 创建一个新的符号并插入符号表
-void STable::insert(const std::string &ident, const std::string &name, SysYType::TYPE _type, int value){
-    SysYType *ty = new SysYType(_type, value);
-    Symbol *sym = new Symbol(ident, name, ty);
-    insert(sym);
-}
-
-// 在符号表中插入
-void STable::insertINT(const std::string &ident, const std::string &name){
-    insert(ident, name, SysYType::SYSY_INT, UNKNOWN);
-}
-
-void STable::insertINTCONST(const std::string &ident, const std::string &name, int value){
-    insert(ident, name, SysYType::SYSY_INT_CONST, value);
-}
-
-void STable::insertFUNC(const std::string &ident, const std::string &name, SysYType::TYPE _t){
-    insert(ident, name, _t, UNKNOWN);
-}
-
-// 查找符号表中是否存在标识符
-bool STable::exists(const std::string &ident){
-    return symbol_tb.find(ident) != symbol_tb.end();
-}
-
-// 根据标识符 ident 在符号表中查找并返回对应的 Symbol 对象指针
-Symbol *STable::Search(const std::string &ident){
-    return symbol_tb.find(ident)->second;
-}
-
-// 返回给定标识符 ident 对应的 Symbol 的 value 值
-int STable::getValue(const std::string &ident){
-    return symbol_tb.find(ident)->second->ty->value;
-}
-
-// 返回给定标识符 ident 对应的 Symbol 的 SysYType 指针
-SysYType *STable::getType(const std::string &ident){
-    return symbol_tb.find(ident)->second->ty;
-}
-
-// 返回给定标识符 ident 对应的 Symbol 的 name 属性
-std::string STable::getName(const std::string &ident){
-    return symbol_tb.find(ident)->second->name;
+SStack::~SStack(){
+    for(auto sym : log)
+        delete sym;
 }
-
 // 在栈顶分配一个新的符号表
 void SStack::alloc(){
-    sym_tb_st.emplace_back(new STable());
+    scopes.push_back(log.size());
 }
-// 从栈顶弹出一个符号表
+// 从栈顶弹出一个符号表，恢复被这一层遮蔽的符号
 void SStack::quit(){
-    sym_tb_st.pop_back();
+    size_t start = scopes.back();
+    scopes.pop_back();
+    while(log.size() > start){
+        Symbol *sym = log.back();
+        log.pop_back();
+        binding[sym->ident] = sym->shadowed;
+        delete sym;
+    }
 }
 // 重置名字管理器
 void SStack::resetNameTable(){
@@ -123,65 +82,34 @@ void SStack::resetNameTable(){
 }
 // 插入一个符号
 void SStack::insert(Symbol *symbol){
-    sym_tb_st.back()->insert(symbol);
+    if(symbol->ident >= (int)binding.size())
+        binding.resize(max(idents.size(), (size_t)symbol->ident + 1), nullptr);
+    symbol->shadowed = binding[symbol->ident];
+    binding[symbol->ident] = symbol;
+    log.push_back(symbol);
 }
 // 在当前作用域（栈顶的符号表）中插入一个符号，给定符号标识符、类型和初始值。符号表中的符号名字由 NameTable 生成
-void SStack::insert(const std::string &ident, SysYType::TYPE _type, int value){
-    string name = nt.getName(ident);
-    sym_tb_st.back()->insert(ident, name, _type, value);
+void SStack::insert(int ident, SysYType::TYPE _type, int value){
+    string name = nt.getName(idents.str(ident));
+    insert(new Symbol(ident, name, new SysYType(_type, value)));
 }
-// 插入int
-void SStack::insertINT(const std::string &ident){
-    string name = nt.getName(ident);
-    sym_tb_st.back()->insertINT(ident, name);
+// 插入int，ir_value 以生成的名字命名
+void SStack::insertINT(int ident, IRValue *ir_value){
+    insert(ident, SysYType::SYSY_INT, UNKNOWN);
+    ir_value->name = log.back()->name;
+    log.back()->ir_value = ir_value;
 }
 // 插入const int
-void SStack::insertINTCONST(const std::string &ident, int value){
-    string name = nt.getName(ident);
-    sym_tb_st.back()->insertINTCONST(ident, name, value);
+void SStack::insertINTCONST(int ident, int value){
+    insert(ident, SysYType::SYSY_INT_CONST, value);
 }
 // 插入一个函数符号
-void SStack::insertFUNC(const std::string &ident, SysYType::TYPE _t){
-    string name = "@" + ident;
-    sym_tb_st.back()->insertFUNC(ident, name, _t);
-}
-
-// 一个标识符是否存在于符号表栈中的任何一个作用域
-bool SStack::exists(const std::string &ident){
-    for(int i = (int)sym_tb_st.size() - 1; i >= 0; --i){
-        if(sym_tb_st[i]->exists(ident))
-            return true;
-    }
-    return false;
+void SStack::insertFUNC(int ident, SysYType::TYPE _t, IRFunction *ir_func){
+    Symbol *sym = new Symbol(ident, "@" + string(idents.str(ident)), new SysYType(_t, UNKNOWN));
+    sym->ir_func = ir_func;
+    insert(sym);
 }
 
-// 扫描栈查找并返回符号的值
-int SStack::getValue(const std::string &ident){
-    int i = (int)sym_tb_st.size() - 1;
-    for(; i >= 0; --i){
-        if(sym_tb_st[i]->exists(ident))
-            break;
-    }
-    return sym_tb_st[i]->getValue(ident);
-}
-// 扫描栈查找并返回符号的类型
-SysYType *SStack::getType(const std::string &ident){
-    int i = (int)sym_tb_st.size() - 1;
-    for(; i >= 0; --i){
-        if(sym_tb_st[i]->exists(ident))
-            break;
-    }
-    return sym_tb_st[i]->getType(ident);
-}
-// 查找符号名
-std::string SStack::getName(const std::string &ident){
-    int i = (int)sym_tb_st.size() - 1;
-    for(; i >= 0; --i){
-        if(sym_tb_st[i]->exists(ident))
-            break;
-    }
-    return sym_tb_st[i]->getName(ident);
-}
 // 临时变量名
 std::string SStack::getTmpName(){
     return nt.getTmpName();
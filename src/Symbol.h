@@ -1,11 +1,16 @@
 #pragma once
 #include <bits/stdc++.h>
+#include "IR.h"
+#include "Interner.h"
 
 /*
 NameTable 处理重复的变量名
-Symbol表 表示一个表项 包括标识符 ident、名称 name
-STable 表示一个大表 有标识符 ident、名称 name、类型 type 和值 value 
+Symbol表 表示一个表项 包括标识符 ident、名称 name，以及对应的 IR 值或函数
 SStack 用来处理符号表栈 
+标识符在词法分析时已经驻留为整数 id（见 Interner.h），符号表按 id 组织：
+binding[id] 是当前可见的符号，被它遮蔽的外层符号串在 shadowed 上
+新符号依次记在 log 中，scopes 记录每层作用域在 log 中的起点，退出作用域时按 log 恢复遮蔽的符号
+查找只需要一次数组下标，进入作用域是 O(1)，退出作用域的代价均摊到每次插入上
 */
 class NameTable{
 private:
@@ -39,57 +44,44 @@ class SysYType{
 
 class Symbol{
 public:
-    std::string ident;   // SysY标识符，x,y
+    int ident;           // SysY标识符的 id
     std::string name;    // KoopaIR中的具名变量
     SysYType *ty;
-    Symbol(const std::string &_ident, const std::string &_name, SysYType *_t); // 构造函数：标识符 _ident、名称 _name 和类型指针 _t 
+    IRValue *ir_value = nullptr;    // 变量对应的 alloc / global alloc
+    IRFunction *ir_func = nullptr;  // 函数对应的 IRFunction
+    Symbol *shadowed = nullptr;     // 被遮蔽的外层同名符号
+    Symbol(int _ident, const std::string &_name, SysYType *_t); // 构造函数：标识符 _ident、名称 _name 和类型指针 _t 
     ~Symbol();
 };
 
-class STable{
-public:
-    const int UNKNOWN = -1;
-    std::unordered_map<std::string, Symbol *> symbol_tb;  // ident -> Symbol 
-    STable() = default;
-    ~STable();
-    void insert(Symbol *symbol);
-    // insert 函数重载：根据标识符 ident、名称 name、类型 _type 和值 value 创建一个新的符号并插入符号表
-    void insert(const std::string &ident, const std::string &name, SysYType::TYPE _type, int value);
-    // 在符号表中插入
-    void insertINT(const std::string &ident, const std::string &name);
-    void insertINTCONST(const std::string &ident, const std::string &name, int value);
-    void insertFUNC(const std::string &ident, const std::string &name, SysYType::TYPE _t);
-    bool exists(const std::string &ident); // 给出标识符查找是否存在
-    Symbol *Search(const std::string &ident);
-    // 根据标识符 ident 在符号表中查找并返回对应的 Symbol 对象指针
-    int getValue(const std::string &ident);
-    // 返回value 值
-    SysYType *getType(const std::string &ident);
-    // 返回SysYType 指针
-    std::string getName(const std::string &ident);
-    // 返回 name 
-};
-
 class SStack{
 private:
-    std::deque<std::unique_ptr<STable>> sym_tb_st;
+    std::vector<Symbol *> binding;  // 标识符 id -> 当前可见的符号
+    std::vector<Symbol *> log;      // 按插入顺序记录的符号
+    std::vector<size_t> scopes;     // 每层作用域在 log 中的起点
     NameTable nt;
 public:
     const int UNKNOWN = -1;
+    ~SStack();
     void alloc();// 在栈顶分配一个新的符号表
     void quit();// 从栈顶弹出一个符号表
     void resetNameTable();
     void insert(Symbol *symbol);// 插入一个符号
-    void insert(const std::string &ident, SysYType::TYPE _type, int value);
-    void insertINT(const std::string &ident);
-    void insertINTCONST(const std::string &ident, int value);
-    void insertFUNC(const std::string &ident, SysYType::TYPE _t);
+    void insert(int ident, SysYType::TYPE _type, int value);
+    void insertINT(int ident, IRValue *ir_value);   // 同时给 ir_value 命名
+    void insertINTCONST(int ident, int value);
+    void insertFUNC(int ident, SysYType::TYPE _t, IRFunction *ir_func);
     // 上述为插入各个类型的符号
-    bool exists(const std::string &ident);// 一个标识符是否存在于符号表栈中的任何一个作用域
-    int getValue(const std::string &ident);// 查找值
-    SysYType *getType(const std::string &ident);// 查找符号的类型
-    std::string getName(const std::string &ident);// 查找name
+    Symbol *lookup(int ident) const {   // 查找当前可见的符号，不存在时返回 nullptr
+        return ident < (int)binding.size() ? binding[ident] : nullptr;
+    }
+    bool exists(int ident) const { return lookup(ident) != nullptr; }// 一个标识符是否存在于符号表栈中的任何一个作用域
+    int getValue(int ident) const { return lookup(ident)->ty->value; }// 查找值
+    SysYType *getType(int ident) const { return lookup(ident)->ty; }// 查找符号的类型
+    const std::string &getName(int ident) const { return lookup(ident)->name; }// 查找name
+    IRValue *getIRValue(int ident) const { return lookup(ident)->ir_value; }// 查找变量对应的IR值
+    IRFunction *getIRFunc(int ident) const { return lookup(ident)->ir_func; }// 查找函数对应的IRFunction
     std::string getTmpName();   // 继承 name manager
     std::string getLabelName(const std::string &label_ident); // 继承 name manager
     std::string getVarName(const std::string& var);   // 获取 var name
-};
\ No newline at end of file
+};
@@ -0,0 +1,93 @@
+#include "Pass.h"
+#include "CFG.h"
+#include <string>
+#include <unordered_map>
+using namespace std;
+
+/*
+尾递归改为循环
+call 自己之后紧跟着 ret 这个结果（或者都没有值）的块，改为带着实参跳回函数开头
+1. 原来的入口块加上和函数参数一一对应的块参数，函数中对参数的使用都换成这些块参数
+2. 新建一个入口块，把 alloc 移到这里，然后把函数参数传给原来的入口块
+   新的入口块沿用 %entry 的名字，原来的入口改名为 %tail_<编号>，编号在整个程序内唯一
+3. 实参可能指向当前函数的栈帧时不能改写，原来的栈帧在递归调用期间还要保留
+不是自己调用自己的尾调用由后端处理，复用当前的栈帧直接跳过去
+*/
+
+static int tails = 0;       // 改名后的入口块的编号
+
+// 块是否以 call func(...); ret 结尾，ret 返回的是 call 的结果或者都没有值
+static bool selfTailCall(IRFunction *func, IRBasicBlock *bb){
+    size_t n = bb->insts.size();
+    if(n < 2)
+        return false;
+    IRValue *call = bb->insts[n - 2], *ret = bb->insts[n - 1];
+    if(call->tag != IRValue::CALL || call->callee != func || ret->tag != IRValue::RETURN)
+        return false;
+    if(!(ret->ops.empty() ? !call->hasResult() : ret->ops[0] == call))
+        return false;
+    for(auto arg : call->ops){
+        if(mayPointToFrame(arg))
+            return false;
+    }
+    return true;
+}
+
+void tailRecursion(IRFunction *func){
+    vector<IRBasicBlock *> sites;
+    for(auto bb : func->bbs){
+        if(selfTailCall(func, bb))
+            sites.push_back(bb);
+    }
+    if(sites.empty())
+        return;
+
+    IRBasicBlock *header = func->bbs[0];
+    unordered_map<IRValue *, IRValue *> replace;
+    for(auto fp : func->params){
+        IRValue *p = func->newValue(IRValue::BLOCK_ARG_REF, fp->ty);
+        p->value = header->params.size();
+        p->bb = header;
+        header->params.push_back(p);
+        replace[fp] = p;
+    }
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            for(auto &op : v->ops){
+                auto it = replace.find(op);
+                if(it != replace.end())
+                    op = it->second;
+            }
+        }
+    }
+
+    // 尾调用改为跳回原来的入口
+    for(auto bb : sites){
+        IRValue *call = bb->insts[bb->insts.size() - 2];
+        bb->insts.resize(bb->insts.size() - 2);
+        IRValue *jump = func->newValue(IRValue::JUMP, IRType::getUnit());
+        jump->ops = call->ops;
+        jump->target[0] = header;
+        jump->bb = bb;
+        bb->insts.push_back(jump);
+    }
+
+    IRBasicBlock *entry = func->newBasicBlock(header->name);
+    header->name = "%tail_" + to_string(tails++);
+    vector<IRValue *> insts;
+    for(auto v : header->insts){
+        if(v->tag == IRValue::ALLOC){
+            v->bb = entry;
+            entry->insts.push_back(v);
+        } else {
+            insts.push_back(v);
+        }
+    }
+    header->insts = insts;
+    IRValue *jump = func->newValue(IRValue::JUMP, IRType::getUnit());
+    jump->ops = func->params;
+    jump->target[0] = header;
+    jump->bb = entry;
+    entry->insts.push_back(jump);
+    func->bbs.insert(func->bbs.begin(), entry);
+}
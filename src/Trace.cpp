@@ -0,0 +1,52 @@
+#include "Trace.h"
+
+Tracer tracer;
+
+static const size_t TRACE_BUF_SIZE = 1 << 16;
+
+bool Tracer::open(const char *path){
+    close();
+    out = fopen(path, "w");
+    if(out == nullptr)
+        return false;
+    setvbuf(out, nullptr, _IOFBF, TRACE_BUF_SIZE);
+    depth = 0;
+    return true;
+}
+
+void Tracer::close(){
+    if(out != nullptr)
+        fclose(out);
+    out = nullptr;
+}
+
+void Tracer::indent(){
+    static const char spaces[] = "                                ";
+    int n = depth * 2;
+    while(n > 0){
+        int k = n < (int)sizeof(spaces) - 1 ? n : (int)sizeof(spaces) - 1;
+        fwrite(spaces, 1, k, out);
+        n -= k;
+    }
+}
+
+void Tracer::enter(const char *type, const char *name){
+    indent();
+    fputs(type, out);
+    if(name != nullptr && name[0] != '\0')
+        fprintf(out, " (%s)", name);
+    fputs("{\n", out);
+    ++depth;
+}
+
+void Tracer::enter(const char *type, int number){
+    indent();
+    fprintf(out, "%s (%d){\n", type, number);
+    ++depth;
+}
+
+void Tracer::leave(){
+    --depth;
+    indent();
+    fputs("}\n", out);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdio>
+
+// 编译时开关，构建时用 -DENABLE_TRACE=0 关闭后 TRACE_SCOPE 展开为空，参数也不会求值
+#ifndef ENABLE_TRACE
+#define ENABLE_TRACE 1
+#endif
+
+/*
+遍历 AST 时的跟踪输出，每进入一个节点输出 "类型 (名字){"，离开时输出 "}"，每层缩进两个空格
+运行时用 -trace <文件> 打开，没有打开时每个节点只多一次判断
+输出写入带大缓冲区的文件，不会每行刷新
+*/
+class Tracer{
+private:
+    FILE *out = nullptr;
+    int depth = 0;
+    void indent();
+public:
+    ~Tracer(){ close(); }
+    bool open(const char *path);
+    void close();
+    bool enabled() const { return out != nullptr; }
+    void enter(const char *type, const char *name);
+    void enter(const char *type, int number);
+    void leave();
+};
+
+extern Tracer tracer;
+
+// 作用域内的跟踪，构造时进入，析构时离开
+class TraceScope{
+private:
+    bool on;
+public:
+    explicit TraceScope(const char *type, const char *name = nullptr): on(tracer.enabled()){
+        if(on) tracer.enter(type, name);
+    }
+    TraceScope(const char *type, int number): on(tracer.enabled()){
+        if(on) tracer.enter(type, number);
+    }
+    ~TraceScope(){
+        if(on) tracer.leave();
+    }
+};
+
+#if ENABLE_TRACE
+#define TRACE_SCOPE(...) TraceScope trace_scope(__VA_ARGS__)
+#else
+#define TRACE_SCOPE(...) ((void)0)
+#endif
@@ -0,0 +1,406 @@
+#include "Pass.h"
+#include "CFG.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+using namespace std;
+
+/*
+循环展开
+只处理最内层的计数循环：header 中只有一条比较和 br，比较的一边是 header 的块参数 i，
+另一边是循环外定义的 n，循环只从 header 退出，所有回边给 i 传的都是 i 加上同一个常量 step，
+继续循环的条件整理成 i lt/le/gt/ge n，并且 i 向 n 靠近（lt/le 时 step > 0，gt/ge 时 step < 0）
+1. 初值和 n 都是常量、次数不超过 MAX_FULL_TRIPS 并且展开之后不超过 MAX_UNROLLED 条指令时完全展开：
+   循环体按次数复制、依次相连，最后一份直接跳到出口，原来的循环变为不可达
+2. 否则按 pass_options.unroll_factor 展开 U 份：新的 header 比较 i 和循环外算好的 n - (U - 1) * step，
+   即第 U 次之前条件是否还成立，成立时依次执行 U 份循环体再回到新的 header，
+   不成立时进入原来的循环执行剩下的次数
+   n 是常量时检查 n - (U - 1) * step 不溢出；否则先在 guard 块中比较 n 和 INT_MIN + (U - 1) * step
+   （step < 0 时是 INT_MAX + (U - 1) * step），会溢出时直接进入原来的循环
+每一份循环体前有一个参数和 header 相同的块，回边改为跳到下一份的这个块，
+之后的 constFold 和 simplifyCFG 把常量传进去并把这些块合并
+*/
+
+static const int MAX_FULL_TRIPS = 16;
+static const size_t MAX_UNROLLED = 160;
+
+static int copies = 0;      // 复制出的块的后缀编号，在整个程序内唯一
+
+namespace {
+
+// 识别出的计数循环
+struct Counted{
+    IRBasicBlock *header, *pre;     // pre 是循环外唯一的前驱
+    vector<IRBasicBlock *> body;    // header 以外的块
+    size_t iv;                      // i 是 header 的第几个参数
+    IRValue::OP op;                 // 继续循环的条件 i op n
+    IRValue *bound;
+    int step;
+    int in;                         // header 的 br 进入循环体的一边
+    size_t size;                    // 循环体的指令数
+};
+
+}
+
+static IRValue::OP negated(IRValue::OP op){
+    switch(op){
+        case IRValue::OP_LT: return IRValue::OP_GE;
+        case IRValue::OP_LE: return IRValue::OP_GT;
+        case IRValue::OP_GT: return IRValue::OP_LE;
+        default: return IRValue::OP_LT;
+    }
+}
+
+// a op b 即 b reversed(op) a
+static IRValue::OP reversed(IRValue::OP op){
+    switch(op){
+        case IRValue::OP_LT: return IRValue::OP_GT;
+        case IRValue::OP_LE: return IRValue::OP_GE;
+        case IRValue::OP_GT: return IRValue::OP_LT;
+        default: return IRValue::OP_LE;
+    }
+}
+
+static bool recognize(IRFunction *func, const CFG &cfg, const Loop &loop, Counted &c){
+    IRBasicBlock *header = cfg.rpo[loop.header];
+    c.header = header;
+    if(header->insts.size() != 2)
+        return false;
+    IRValue *cmp = header->insts[0], *br = header->insts[1];
+    if(br->tag != IRValue::BRANCH || br->ops[0] != cmp || cmp->tag != IRValue::BINARY)
+        return false;
+    if(cmp->op != IRValue::OP_LT && cmp->op != IRValue::OP_LE && cmp->op != IRValue::OP_GT && cmp->op != IRValue::OP_GE)
+        return false;
+
+    unordered_set<IRValue *> inside;
+    for(int b : loop.blocks){
+        IRBasicBlock *bb = cfg.rpo[b];
+        for(auto p : bb->params)
+            inside.insert(p);
+        for(auto v : bb->insts)
+            inside.insert(v);
+        if(b == loop.header)
+            continue;
+        // 只从 header 退出
+        for(int s : cfg.succs[b]){
+            if(!loop.contains(s))
+                return false;
+        }
+        c.body.push_back(bb);
+    }
+    c.size = 0;
+    for(auto bb : c.body)
+        c.size += bb->insts.size();
+
+    // br 一边进入循环体，另一边退出
+    bool t0 = cfg.reachable(br->target[0]) && loop.contains(cfg.index.at(br->target[0]));
+    bool t1 = cfg.reachable(br->target[1]) && loop.contains(cfg.index.at(br->target[1]));
+    if(t0 == t1 || br->target[t0 ? 0 : 1] == header)
+        return false;
+    c.in = t0 ? 0 : 1;
+
+    // 比较的结果只用作 br 的条件
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            if(v != br && find(v->ops.begin(), v->ops.end(), cmp) != v->ops.end())
+                return false;
+        }
+    }
+    auto &hp = header->params;
+    auto it = find(hp.begin(), hp.end(), cmp->ops[0]);
+    c.op = cmp->op;
+    c.bound = cmp->ops[1];
+    if(it == hp.end()){
+        it = find(hp.begin(), hp.end(), cmp->ops[1]);
+        c.op = reversed(cmp->op);
+        c.bound = cmp->ops[0];
+    }
+    if(it == hp.end() || inside.count(c.bound))
+        return false;
+    c.iv = it - hp.begin();
+    if(c.in == 1)
+        c.op = negated(c.op);
+
+    // 所有回边上 i 的步长相同
+    bool first = true;
+    for(int l : loop.latches){
+        IRValue *term = cfg.rpo[l]->insts.back();
+        for(int t = 0; t < 2; ++t){
+            if(term->target[t] != header)
+                continue;
+            int step;
+            if(!stepOf(term->getArgs(t)[c.iv], *it, step) || (!first && step != c.step))
+                return false;
+            c.step = step;
+            first = false;
+        }
+    }
+    bool up = c.op == IRValue::OP_LT || c.op == IRValue::OP_LE;
+    if(first || (up ? c.step <= 0 : c.step >= 0))
+        return false;
+
+    vector<int> outside;
+    for(int p : cfg.preds[loop.header]){
+        if(!loop.contains(p))
+            outside.push_back(p);
+    }
+    if(outside.size() != 1)
+        return false;
+    c.pre = cfg.rpo[outside[0]];
+    IRValue *term = c.pre->insts.back();
+    return !(term->tag == IRValue::BRANCH && term->target[0] == header && term->target[1] == header);
+}
+
+// 常量初值和边界时的循环次数，不是常量时返回 -1
+static long long tripCount(const Counted &c){
+    IRValue *term = c.pre->insts.back();
+    int t = term->target[0] == c.header ? 0 : 1;
+    IRValue *init = term->getArgs(t)[c.iv];
+    if(init->tag != IRValue::INTEGER || c.bound->tag != IRValue::INTEGER)
+        return -1;
+    long long i = init->value, n = c.bound->value, s = c.step;
+    switch(c.op){
+        case IRValue::OP_LT: return i < n ? (n - i + s - 1) / s : 0;
+        case IRValue::OP_LE: return i <= n ? (n - i) / s + 1 : 0;
+        case IRValue::OP_GT: return i > n ? (i - n - s - 1) / -s : 0;
+        default: return i >= n ? (i - n) / -s + 1 : 0;
+    }
+}
+
+// 参数和 header 相同的块
+static IRBasicBlock *headerCopy(IRFunction *func, IRBasicBlock *header){
+    IRBasicBlock *bb = func->newBasicBlock(header->name + "_u" + to_string(copies++));
+    for(auto hp : header->params){
+        IRValue *p = func->newValue(IRValue::BLOCK_ARG_REF, hp->ty);
+        p->value = bb->params.size();
+        p->bb = bb;
+        bb->params.push_back(p);
+    }
+    return bb;
+}
+
+// 复制一份循环体，header 的参数替换为 entry 的参数，回边改为跳到 next
+// entry 以 jump 进入复制的循环体结尾，新的块依次加入 out
+static void cloneBody(IRFunction *func, const Counted &c, IRBasicBlock *entry, IRBasicBlock *next,
+                      vector<IRBasicBlock *> &out){
+    string suffix = "_u" + to_string(copies++);
+    unordered_map<IRValue *, IRValue *> vmap;
+    unordered_map<IRBasicBlock *, IRBasicBlock *> bmap;
+    for(size_t i = 0; i < c.header->params.size(); ++i)
+        vmap[c.header->params[i]] = entry->params[i];
+    vector<IRBasicBlock *> bbs;
+    for(auto cb : c.body){
+        IRBasicBlock *nb = func->newBasicBlock(cb->name + suffix);
+        bmap[cb] = nb;
+        bbs.push_back(nb);
+        for(auto p : cb->params){
+            IRValue *np = func->newValue(p->tag, p->ty);
+            *np = *p;
+            np->name = p->name.empty() ? "" : p->name + suffix;
+            np->bb = nb;
+            nb->params.push_back(np);
+            vmap[p] = np;
+        }
+        for(auto v : cb->insts){
+            IRValue *nv = func->newValue(v->tag, v->ty);
+            *nv = *v;
+            nv->name = v->name.empty() ? "" : v->name + suffix;
+            nv->bb = nb;
+            nb->insts.push_back(nv);
+            vmap[v] = nv;
+        }
+    }
+    for(auto nb : bbs){
+        for(auto v : nb->insts){
+            for(auto &op : v->ops){
+                auto it = vmap.find(op);
+                if(it != vmap.end())
+                    op = it->second;
+            }
+            for(int t = 0; t < 2; ++t){
+                if(v->target[t] != nullptr)
+                    v->target[t] = v->target[t] == c.header ? next : bmap[v->target[t]];
+            }
+        }
+    }
+
+    // entry 进入循环体时传的值就是 header 的 br 传的值
+    IRValue *br = c.header->insts.back();
+    IRValue *jump = func->newValue(IRValue::JUMP, IRType::getUnit());
+    jump->target[0] = bmap[br->target[c.in]];
+    for(auto a : br->getArgs(c.in)){
+        auto it = vmap.find(a);
+        jump->ops.push_back(it != vmap.end() ? it->second : a);
+    }
+    jump->bb = entry;
+    entry->insts.push_back(jump);
+    out.push_back(entry);
+    out.insert(out.end(), bbs.begin(), bbs.end());
+}
+
+// 循环外的前驱改为跳到 bb
+static void redirect(const Counted &c, IRBasicBlock *bb){
+    IRValue *term = c.pre->insts.back();
+    for(int t = 0; t < 2; ++t){
+        if(term->target[t] == c.header)
+            term->target[t] = bb;
+    }
+}
+
+static void fullUnroll(IRFunction *func, const Counted &c, int trips){
+    vector<IRBasicBlock *> bbs;
+    IRBasicBlock *entry = headerCopy(func, c.header);
+    redirect(c, entry);
+    for(int k = 0; k < trips; ++k){
+        IRBasicBlock *next = headerCopy(func, c.header);
+        cloneBody(func, c, entry, next, bbs);
+        entry = next;
+    }
+    // 最后一份之后跳到出口
+    IRValue *br = c.header->insts.back();
+    IRValue *jump = func->newValue(IRValue::JUMP, IRType::getUnit());
+    jump->target[0] = br->target[1 - c.in];
+    jump->ops = br->getArgs(1 - c.in);
+    jump->bb = entry;
+    entry->insts.push_back(jump);
+    bbs.push_back(entry);
+    func->bbs.insert(find(func->bbs.begin(), func->bbs.end(), c.header), bbs.begin(), bbs.end());
+
+    // header 支配循环之后的代码，那里用到的 header 参数替换为最后的 entry 的参数
+    unordered_map<IRValue *, IRValue *> replace;
+    for(size_t i = 0; i < c.header->params.size(); ++i)
+        replace[c.header->params[i]] = entry->params[i];
+    unordered_set<IRBasicBlock *> loop(c.body.begin(), c.body.end());
+    loop.insert(c.header);
+    for(auto bb : func->bbs){
+        if(loop.count(bb))
+            continue;
+        for(auto v : bb->insts){
+            for(auto &op : v->ops){
+                auto it = replace.find(op);
+                if(it != replace.end())
+                    op = it->second;
+            }
+        }
+    }
+}
+
+// 返回展开后的新 header，不能展开时返回 nullptr
+static IRBasicBlock *partialUnroll(IRProgram &program, IRFunction *func, const Counted &c, int factor){
+    long long adjust = (long long)(factor - 1) * c.step;
+    if(adjust < INT32_MIN || adjust > INT32_MAX)
+        return nullptr;
+    IRValue *bound;
+    if(c.bound->tag == IRValue::INTEGER){
+        long long n = c.bound->value - adjust;
+        if(n < INT32_MIN || n > INT32_MAX)
+            return nullptr;
+        bound = program.getInteger(n);
+    }
+
+    // 新的 header：i op n - (U - 1) * step 时进入展开的循环体，否则进入原来的循环
+    IRBasicBlock *head = headerCopy(func, c.header);
+    IRBasicBlock *guard = nullptr;
+    if(c.bound->tag == IRValue::INTEGER){
+        redirect(c, head);
+    } else {
+        // guard 块检查 n - (U - 1) * step 不溢出，之后算出新的边界
+        guard = headerCopy(func, c.header);
+        redirect(c, guard);
+        IRValue *ok = func->newValue(IRValue::BINARY, IRType::getInt32());
+        bool up = c.step > 0;
+        ok->op = up ? IRValue::OP_GE : IRValue::OP_LE;
+        ok->ops = {c.bound, program.getInteger((up ? INT32_MIN : INT32_MAX) + adjust)};
+        ok->bb = guard;
+        guard->insts.push_back(ok);
+        bound = func->newValue(IRValue::BINARY, IRType::getInt32());
+        bound->op = IRValue::OP_SUB;
+        bound->ops = {c.bound, program.getInteger(adjust)};
+        bound->bb = guard;
+        guard->insts.push_back(bound);
+        IRValue *br = func->newValue(IRValue::BRANCH, IRType::getUnit());
+        br->ops = {ok};
+        br->ops.insert(br->ops.end(), guard->params.begin(), guard->params.end());
+        br->true_args = guard->params.size();
+        br->ops.insert(br->ops.end(), guard->params.begin(), guard->params.end());
+        br->target[0] = head;
+        br->target[1] = c.header;
+        br->bb = guard;
+        guard->insts.push_back(br);
+    }
+    IRValue *cmp = func->newValue(IRValue::BINARY, IRType::getInt32());
+    cmp->op = c.op;
+    cmp->ops = {head->params[c.iv], bound};
+    cmp->bb = head;
+    head->insts.push_back(cmp);
+
+    vector<IRBasicBlock *> bbs;
+    IRBasicBlock *entry = headerCopy(func, c.header);
+    IRBasicBlock *first = entry;
+    for(int k = 0; k < factor; ++k){
+        IRBasicBlock *next = k + 1 < factor ? headerCopy(func, c.header) : head;
+        cloneBody(func, c, entry, next, bbs);
+        entry = next;
+    }
+    IRValue *br = func->newValue(IRValue::BRANCH, IRType::getUnit());
+    br->ops = {cmp};
+    br->ops.insert(br->ops.end(), head->params.begin(), head->params.end());
+    br->true_args = head->params.size();
+    br->ops.insert(br->ops.end(), head->params.begin(), head->params.end());
+    br->target[0] = first;
+    br->target[1] = c.header;
+    br->bb = head;
+    head->insts.push_back(br);
+    bbs.insert(bbs.begin(), head);
+    if(guard != nullptr)
+        bbs.insert(bbs.begin(), guard);
+    func->bbs.insert(find(func->bbs.begin(), func->bbs.end(), c.header), bbs.begin(), bbs.end());
+    return head;
+}
+
+bool unrollLoops(IRProgram &program, IRFunction *func){
+    int factor = pass_options.unroll_factor;
+    if(factor <= 1)
+        return false;
+    // 展开之后的块会成为别的循环的前驱，每处理一个循环都重新分析
+    unordered_set<IRBasicBlock *> done;
+    bool changed = false;
+    while(true){
+        CFG cfg(func);
+        auto loops = findLoops(cfg);
+        auto it = find_if(loops.begin(), loops.end(), [&](const Loop &loop){
+            if(done.count(cfg.rpo[loop.header]))
+                return false;
+            for(auto &other : loops){
+                if(&other != &loop && loop.contains(other.header))
+                    return false;
+            }
+            return true;
+        });
+        if(it == loops.end())
+            break;
+        done.insert(cfg.rpo[it->header]);
+        Counted c;
+        if(!recognize(func, cfg, *it, c))
+            continue;
+        long long trips = tripCount(c);
+        if(trips > 0 && trips <= MAX_FULL_TRIPS && c.size * trips <= MAX_UNROLLED){
+            fullUnroll(func, c, trips);
+            // 原来的循环不可达，块参数只从回边收到值，留给 constFold 会替换成用到它自己的值
+            removeUnreachable(func);
+            changed = true;
+        } else if(trips < 0 || trips >= factor){
+            if(c.size * factor > MAX_UNROLLED)
+                continue;
+            // 展开的循环和余数循环都不再处理
+            IRBasicBlock *head = partialUnroll(program, func, c, factor);
+            if(head != nullptr){
+                done.insert(head);
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
@@ -1,24 +1,53 @@
 #include <bits/stdc++.h>
 #include "AST.h"
-#include "koopa.h"
+#include "IR.h"
+#include "Pass.h"
 #include "visit.h"
 #include "utils.h"
 #include "Symbol.h"
+#include "Trace.h"
 using namespace std;
 
 extern FILE *yyin;
-extern int yyparse(unique_ptr<BaseAST> &ast);
+extern int yyparse(BaseAST *&ast);
 
 extern RiscvString rvs;
 extern KoopaIR ki;
 
 int main(int argc, const char *argv[]) {
     // 解析命令行参数
-    // compiler 模式 输入文件 -o 输出文件
-    assert(argc == 5);
+    // compiler 模式 输入文件 -o 输出文件 [-trace 跟踪文件] [-stats] [-no-peephole] [-layout] [-inline 阈值] [-unroll 份数]
+    assert(argc >= 5);
     auto mode = argv[1];
     auto input = argv[2];
     auto output = argv[4];
+    bool stats = false;
+    for(int i = 5; i < argc; ++i){
+        if(!strcmp(argv[i], "-stats")){
+            stats = true;
+        } else if(!strcmp(argv[i], "-no-peephole")){
+            rvs.optimize = false;
+        } else if(!strcmp(argv[i], "-layout")){
+            pass_options.layout_dump = &cerr;
+        } else if(!strcmp(argv[i], "-inline") && i + 1 < argc){
+            pass_options.inline_threshold = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "-unroll") && i + 1 < argc){
+            pass_options.unroll_factor = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "-trace") && i + 1 < argc){
+            const char *path = argv[++i];
+#if ENABLE_TRACE
+            if(!tracer.open(path)){
+                cerr << "cannot open trace file " << path << endl;
+                return 1;
+            }
+#else
+            cerr << "tracing is disabled at compile time, ignoring " << path << endl;
+#endif
+        } else {
+            cerr << "unknown option " << argv[i] << endl;
+            return 1;
+        }
+    }
 
     // 打开输入文件, 并且指定 lexer 在解析的时候读取这个文件
     yyin = fopen(input, "r");
@@ -38,39 +67,32 @@ int main(int argc, const char *argv[]) {
     // fhaha.close();ihaha.close();return 0;
     
     // 调用 parser 函数, parser 函数会进一步调用 lexer 解析输入文件的
-    unique_ptr<BaseAST> base_ast;
-    unique_ptr<CompUnitAST> ast;
+    BaseAST *base_ast = nullptr;
     auto ret = yyparse(base_ast);
     assert(!ret);
 
-    ast.reset((CompUnitAST *)base_ast.release());
+    CompUnitAST *ast = (CompUnitAST *)base_ast;
+    // 生成内存中的 Koopa IR，后端直接使用，不再经过文本
     ast->Dump();
-    
-    const char *str = ki.c_str();
+    tracer.close();
+    // 之后不再需要语法树，整体释放
+    ast_arena.release();
+    optimize(ki.program);
 
     if(!strcmp(mode,"-koopa")){
-        fout << str; 
+        ki.program.dump(fout);
         fout.close();
         return 0;
     }
-    // 解析字符串 str, 得到 Koopa IR 程序
-    koopa_program_t program;
-    koopa_error_code_t err_c = koopa_parse_from_string(str, &program);
-    assert(err_c == KOOPA_EC_SUCCESS);  // 确保解析时没有出错
-    // 创建一个 raw program builder, 用来构建 raw program
-    koopa_raw_program_builder_t builder = koopa_new_raw_program_builder();
-    // 将 Koopa IR 程序转换为 raw program
-    koopa_raw_program_t raw = koopa_build_raw_program(builder, program);
-    // 释放 Koopa IR 程序占用的内存
-    koopa_delete_program(program);
-    // 处理 raw program
-    Visit(raw);
-    fout << rvs.c_str();
+    // 处理 IR program
+    rvs.open(fout);
+    Visit(ki.program);
+    rvs.flush();
+    if(stats){
+        rvs.peephole.report(cerr);
+        cerr << "relaxed branches " << rvs.relaxed << endl;
+    }
     fout.close();
-    // 处理完成, 释放 raw program builder 占用的内存
-    // 注意, raw program 中所有的指针指向的内存均为 raw program builder 的内存
-    // 所以不要在 raw program 处理完毕之前释放 builder
-    koopa_delete_raw_program_builder(builder);
 
     return 0;
 }
\ No newline at end of file
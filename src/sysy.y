@@ -13,39 +13,38 @@
 
 // 声明 lexer 函数和错误处理函数
 int yylex();
-void yyerror(std::unique_ptr<BaseAST> &ast, const char *s);
+void yyerror(BaseAST *&ast, const char *s);
 
 using namespace std;
 
 %}
 
 // 定义 parser 函数和错误处理函数的附加参数
-// 我们需要返回一个字符串作为 AST, 所以我们把附加参数定义成字符串的智能指针
-%parse-param { std::unique_ptr<BaseAST> &ast }
+// 我们需要返回 AST 的根节点, 节点都在 ast_arena 中, 所以用裸指针的引用
+%parse-param { BaseAST *&ast }
 
 // yylval 的定义
 %union {
-  std::string *str_val;
-  int int_val;
+  int int_val;            // 整数字面量, 或者标识符在 Interner 中的 id
   char char_val;
   BaseAST *ast_val;
 }
 
 // 终极符类型 词法分析返回的所有 token 种类的声明 
-// 注意 IDENT 和 INT_CONST 会返回 token 的值, 分别对应 str_val 和 int_val
+// 注意 IDENT 和 INT_CONST 会返回 token 的值, 都是 int_val, IDENT 返回的是标识符的 id
 %token VOID INT RETURN LESS_EQ GREAT_EQ EQUAL NOT_EQUAL AND OR CONST IF ELSE WHILE BREAK CONTINUE
-%token <str_val> IDENT
+%token <int_val> IDENT
 %token <int_val> INT_CONST
 
 // 非终结符类型 自己根据要加入的内容定义
-%type <ast_val> FuncDef Block Stmt Exp PrimaryExp UnaryExp MulExp AddExp RelExp EqExp LAndExp LOrExp Decl ConstDecl VarDecl BType ConstDef VarDef ConstDefList VarDefList ConstInitVal InitVal BlockItemList BlockItem LVal ConstExp MatchedStmt OpenStmt OtherStmt GlobalFuncVarList DeclOrFuncDef FuncFParams FuncFParam FuncRParams InitValList ConstInitValList
+%type <ast_val> FuncDef Block Stmt Exp PrimaryExp UnaryExp MulExp AddExp RelExp EqExp LAndExp LOrExp Decl ConstDecl VarDecl BType ConstDef VarDef ConstDefList VarDefList ConstInitVal InitVal BlockItemList BlockItem LVal ConstExp MatchedStmt OpenStmt OtherStmt GlobalFuncVarList FuncFParams FuncFParam FuncRParams InitValList ConstInitValList
 %type <int_val> Number
 %type <char_val> UnaryOp 
 
 %%
 // 这里提供 语法分析器即parser遇到某种语法规则后做的操作
 // 开始符, CompUnit ::= FuncDef, 大括号后声明了解析完成后 parser 要做的事情
-// 之前我们定义了 FuncDef 会返回一个 str_val, 也就是字符串指针
+// 之前我们定义了 FuncDef 会返回一个 ast_val, 也就是 AST 节点指针
 // 而 parser 一旦解析完 CompUnit, 就说明所有的 token 都被解析了, 即解析结束了
 // 此时我们应该把 FuncDef 返回的结果收集起来, 作为 AST 传给调用 parser 的函数
 // $1 指代规则里第一个符号的返回值, 也就是 FuncDef 的返回值
@@ -54,54 +53,30 @@ using namespace std;
 // 或者2022版https://cdn.hluvmiku.tech/download/sysy2022.pdf 多了float的类型 这里我们没有实现
 CompUnit
   : GlobalFuncVarList {
-    auto comp_unit = unique_ptr<CompUnitAST>((CompUnitAST *)$1);
-    ast = move(comp_unit);
+    ast = (CompUnitAST *)$1;
   }
   ;
 
 //  CompUnit      ::= [CompUnit] (Decl | FuncDef);  []代表0次或者1次 {}代表0次或者多次
+// 左递归, 直接追加到已有的 CompUnitAST 中
 GlobalFuncVarList
-  : DeclOrFuncDef {
-    $$ = $1;
-  } 
-  ;
-
-// 多个声明和函数定义时 使用新指针进行合并
-GlobalFuncVarList
-  : GlobalFuncVarList DeclOrFuncDef{
-    auto comp_unit = new CompUnitAST();
-    auto comp_base = unique_ptr<CompUnitAST>((CompUnitAST *)$1);
-    auto comp_new = unique_ptr<CompUnitAST>((CompUnitAST *)$2);
-    for(auto &f : comp_base->func_defs){
-        comp_unit->func_defs.emplace_back(f.release());
-    }
-    for(auto &f : comp_new->func_defs){
-        comp_unit->func_defs.emplace_back(f.release());
-    }
-    for(auto &d : comp_base->decls){
-        comp_unit->decls.emplace_back(d.release());
-    }
-    for(auto &d : comp_new->decls){
-        comp_unit->decls.emplace_back(d.release());
-    }
-    $$ = comp_unit;
-  } 
-  ;
-
-DeclOrFuncDef
   : Decl {
-    auto comp_unit = new CompUnitAST();
-    comp_unit->decls.emplace_back((DeclAST *)$1);
+    auto comp_unit = ast_arena.make<CompUnitAST>();
+    comp_unit->decls.push_back((DeclAST *)$1);
     $$ = comp_unit;
-  }
-  ;
-  
-DeclOrFuncDef
-  : FuncDef {
-    auto comp_unit = new CompUnitAST();
-    comp_unit->func_defs.emplace_back((FuncDefAST *)$1);
+  } | FuncDef {
+    auto comp_unit = ast_arena.make<CompUnitAST>();
+    comp_unit->func_defs.push_back((FuncDefAST *)$1);
     $$ = comp_unit;
-  } 
+  } | GlobalFuncVarList Decl {
+    auto comp_unit = (CompUnitAST *)$1;
+    comp_unit->decls.push_back((DeclAST *)$2);
+    $$ = comp_unit;
+  } | GlobalFuncVarList FuncDef {
+    auto comp_unit = (CompUnitAST *)$1;
+    comp_unit->func_defs.push_back((FuncDefAST *)$2);
+    $$ = comp_unit;
+  }
   ;
 
 // FuncDef ::= FuncType IDENT '(' ')' Block; 北大的例子
@@ -109,18 +84,15 @@ DeclOrFuncDef
 // 解析完成后, 把这些符号的结果收集起来, 然后拼成一个新的字符串, 作为结果返回
 // $$ 表示非终结符的返回值, 我们可以通过给这个符号赋值的方法来返回结果
 // 你可能会问, FuncType, IDENT 之类的结果已经是字符串指针了
-// 为什么还要用 unique_ptr 接住它们, 然后再解引用, 把它们拼成另一个字符串指针呢
-// 因为所有的字符串指针都是我们 new 出来的, new 出来的内存一定要 delete
-// 否则会发生内存泄漏, 而 unique_ptr 这种智能指针可以自动帮我们 delete
-// 虽然此处你看不出用 unique_ptr 和手动 delete 的区别, 但当我们定义了 AST 之后
-// 这种写法会省下很多内存管理的负担
+// 所有节点和标识符文本都由 ast_arena 分配, 语法树用完后整体释放
+// 所以这里直接保存指针, 不需要逐个 delete
 FuncDef
   : BType IDENT '(' ')' Block {
     
-    auto func_def = new FuncDefAST();
-    func_def->btype = unique_ptr<BTypeAST>((BTypeAST *)$1);
-    func_def->ident = *unique_ptr<string>($2);
-    func_def->block = unique_ptr<BlockAST>((BlockAST *)$5);
+    auto func_def = ast_arena.make<FuncDefAST>();
+    func_def->btype = (BTypeAST *)$1;
+    func_def->ident = $2;
+    func_def->block = (BlockAST *)$5;
     $$ = func_def;
   }
   ;
@@ -128,11 +100,11 @@ FuncDef
 // FuncDef ::= FuncType IDENT '(' FuncFParams ')' Block; FuncType BType
 FuncDef
   : BType IDENT '(' FuncFParams ')' Block {
-    auto func_def = new FuncDefAST();
-    func_def->btype = unique_ptr<BTypeAST>((BTypeAST *)$1);
-    func_def->ident = *unique_ptr<string>($2);
-    func_def->func_params = unique_ptr<FuncFParamsAST>((FuncFParamsAST *)$4);
-    func_def->block = unique_ptr<BlockAST>((BlockAST *)$6);
+    auto func_def = ast_arena.make<FuncDefAST>();
+    func_def->btype = (BTypeAST *)$1;
+    func_def->ident = $2;
+    func_def->func_params = (FuncFParamsAST *)$4;
+    func_def->block = (BlockAST *)$6;
     $$ = func_def;
   }
   ;
@@ -140,17 +112,12 @@ FuncDef
 // FuncFParams   ::= FuncFParam {"," FuncFParam};
 FuncFParams
   : FuncFParam {
-    auto func_params = new FuncFParamsAST();
-    func_params->func_f_params.emplace_back((FuncFParamAST *)$1);
+    auto func_params = ast_arena.make<FuncFParamsAST>();
+    func_params->func_f_params.push_back((FuncFParamAST *)$1);
     $$ = func_params;
-  } | FuncFParam ',' FuncFParams {
-    auto func_params = new FuncFParamsAST();
-    func_params->func_f_params.emplace_back((FuncFParamAST *)$1);
-    auto params = unique_ptr<FuncFParamsAST>((FuncFParamsAST *)($3));
-    int n = params->func_f_params.size();
-    for(int i = 0; i < n; ++i){
-        func_params->func_f_params.emplace_back(params->func_f_params[i].release());
-    }
+  } | FuncFParams ',' FuncFParam {
+    auto func_params = (FuncFParamsAST *)$1;
+    func_params->func_f_params.push_back((FuncFParamAST *)$3);
     $$ = func_params;
   }
   ;
@@ -158,14 +125,14 @@ FuncFParams
 // FuncFParam    ::= BType IDENT ["[" "]" {"[" ConstExp "]"}];
 FuncFParam
   : BType IDENT {
-    auto func_param = new FuncFParamAST();
-    func_param->btype.reset((BTypeAST *)$1);
-    func_param->ident = *unique_ptr<string>($2);
+    auto func_param = ast_arena.make<FuncFParamAST>();
+    func_param->btype = (BTypeAST *)$1;
+    func_param->ident = $2;
     $$ = func_param;
   } | BType IDENT '[' ']' {
-    auto func_param = new FuncFParamAST();
-    func_param->btype.reset((BTypeAST *)$1);
-    func_param->ident = *unique_ptr<string>($2);
+    auto func_param = ast_arena.make<FuncFParamAST>();
+    func_param->btype = (BTypeAST *)$1;
+    func_param->ident = $2;
     $$ = func_param;
   }
   ;
@@ -179,16 +146,11 @@ Block
 
 BlockItemList
   : {
-    auto block = new BlockAST();
+    auto block = ast_arena.make<BlockAST>();
     $$ = block;
-  } | BlockItem BlockItemList {
-    auto block = new BlockAST();
-    auto block_lst = unique_ptr<BlockAST>((BlockAST *)$2);
-    block->block_items.emplace_back((BlockItemAST *)$1);
-    int n = block_lst->block_items.size();
-    for(int i = 0; i < n; ++i){
-        block->block_items.emplace_back(block_lst->block_items[i].release());
-    }
+  } | BlockItemList BlockItem {
+    auto block = (BlockAST *)$1;
+    block->block_items.push_back((BlockItemAST *)$2);
     $$ = block;
   }
   ;
@@ -196,18 +158,18 @@ BlockItemList
 // BlockItem     ::= Decl | Stmt;
 BlockItem
   : Decl {
-    auto block_item = new BlockItemAST();
+    auto block_item = ast_arena.make<BlockItemAST>();
     block_item->tag = BlockItemAST::DECL;
-    block_item->decl = unique_ptr<DeclAST>((DeclAST *)$1);
+    block_item->decl = (DeclAST *)$1;
     $$ = block_item;
   }
   ;
 
 BlockItem
   : Stmt {
-    auto block_item = new BlockItemAST();
+    auto block_item = ast_arena.make<BlockItemAST>();
     block_item->tag = BlockItemAST::STMT;
-    block_item->stmt = unique_ptr<StmtAST>((StmtAST *)$1);
+    block_item->stmt = (StmtAST *)$1;
     $$ = block_item;
   }
   ;
@@ -215,18 +177,18 @@ BlockItem
 // Decl          ::= ConstDecl | VarDecl;
 Decl 
   : ConstDecl {
-    auto decl = new DeclAST();
+    auto decl = ast_arena.make<DeclAST>();
     decl->tag = DeclAST::CONST_DECL;
-    decl->const_decl = unique_ptr<ConstDeclAST>((ConstDeclAST *)$1);
+    decl->const_decl = (ConstDeclAST *)$1;
     $$ = decl;
   }
   ;
 
 Decl 
   : VarDecl {
-    auto decl = new DeclAST();
+    auto decl = ast_arena.make<DeclAST>();
     decl->tag = DeclAST::VAR_DECL;
-    decl->var_decl = unique_ptr<VarDeclAST>((VarDeclAST *)$1);
+    decl->var_decl = (VarDeclAST *)$1;
     $$ = decl;
   }
   ;
@@ -250,11 +212,11 @@ Stmt
 // MatchedStmt   ::= "if" "(" Exp ")" Stmt ["else" Stmt]
 MatchedStmt
   : IF '(' Exp ')' MatchedStmt ELSE MatchedStmt {
-    auto mat_stmt = new StmtAST();
+    auto mat_stmt = ast_arena.make<StmtAST>();
     mat_stmt->tag = StmtAST::IF;
-    mat_stmt->exp.reset((ExpAST *) $3);
-    mat_stmt->if_stmt.reset((StmtAST *)$5);
-    mat_stmt->else_stmt.reset((StmtAST *)$7);
+    mat_stmt->exp = (ExpAST *)$3;
+    mat_stmt->if_stmt = (StmtAST *)$5;
+    mat_stmt->else_stmt = (StmtAST *)$7;
     $$ = mat_stmt;
   } | OtherStmt {
     $$ = $1;
@@ -264,17 +226,17 @@ MatchedStmt
 // OpenStmt      ::= "if" "(" Exp ")" MatchedStmt ["else" OpenStmt]
  OpenStmt
   : IF '(' Exp ')' Stmt {
-    auto open_stmt = new StmtAST();
+    auto open_stmt = ast_arena.make<StmtAST>();
     open_stmt->tag = StmtAST::IF;
-    open_stmt->exp.reset((ExpAST *)$3);
-    open_stmt->if_stmt.reset((StmtAST *)$5);
+    open_stmt->exp = (ExpAST *)$3;
+    open_stmt->if_stmt = (StmtAST *)$5;
     $$ = open_stmt;
   } | IF '(' Exp ')' MatchedStmt ELSE OpenStmt {
-    auto open_stmt = new StmtAST();
+    auto open_stmt = ast_arena.make<StmtAST>();
     open_stmt->tag = StmtAST::IF;
-    open_stmt->exp.reset((ExpAST *)$3);
-    open_stmt->if_stmt.reset((StmtAST *)$5);
-    open_stmt->else_stmt.reset((StmtAST *)$7);
+    open_stmt->exp = (ExpAST *)$3;
+    open_stmt->if_stmt = (StmtAST *)$5;
+    open_stmt->else_stmt = (StmtAST *)$7;
     $$ = open_stmt;
   }
   ;
@@ -282,16 +244,16 @@ MatchedStmt
 //                 | "return" [Exp] ";";
 OtherStmt
   : RETURN Exp ';' {
-    auto stmt = new StmtAST();
+    auto stmt = ast_arena.make<StmtAST>();
     stmt->tag = StmtAST::RETURN;
-    stmt->exp = unique_ptr<ExpAST>((ExpAST *)$2);
+    stmt->exp = (ExpAST *)$2;
     $$ = stmt;
   }
   ;
 
 OtherStmt
   : RETURN  ';' {
-    auto stmt = new StmtAST();
+    auto stmt = ast_arena.make<StmtAST>();
     stmt->tag = StmtAST::RETURN;
     $$ = stmt;
   }
@@ -300,10 +262,10 @@ OtherStmt
 // Stmt          ::= LVal "=" Exp ";"
 OtherStmt 
   : LVal '=' Exp ';' {
-    auto stmt = new StmtAST();
+    auto stmt = ast_arena.make<StmtAST>();
     stmt->tag = StmtAST::ASSIGN;
-    stmt->exp.reset((ExpAST *) $3);
-    stmt->lval.reset((LValAST *) $1);
+    stmt->exp = (ExpAST *)$3;
+    stmt->lval = (LValAST *)$1;
     $$ = stmt;
   }
   ;
@@ -311,13 +273,13 @@ OtherStmt
 //                 | [Exp] ";"
 OtherStmt
   : ';' {
-    auto stmt = new StmtAST();
+    auto stmt = ast_arena.make<StmtAST>();
     stmt->tag = StmtAST::EXP;
     $$ = stmt;
   } | Exp ';' {
-    auto stmt = new StmtAST();
+    auto stmt = ast_arena.make<StmtAST>();
     stmt->tag = StmtAST::EXP;
-    stmt->exp.reset((ExpAST *)$1);
+    stmt->exp = (ExpAST *)$1;
     $$ = stmt;
   }
   ;
@@ -325,9 +287,9 @@ OtherStmt
 //                 | Block
 OtherStmt
   : Block {
-    auto stmt = new StmtAST();
+    auto stmt = ast_arena.make<StmtAST>();
     stmt->tag = StmtAST::BLOCK;
-    stmt->block.reset((BlockAST *)$1);
+    stmt->block = (BlockAST *)$1;
     $$ = stmt;
   }
   ;
@@ -336,10 +298,10 @@ OtherStmt
 //                 | "while" "(" Exp ")" Stmt
 OtherStmt
   : WHILE '(' Exp ')' Stmt {
-    auto stmt = new StmtAST();
+    auto stmt = ast_arena.make<StmtAST>();
     stmt->tag = StmtAST::WHILE;
-    stmt->exp.reset((ExpAST *)$3);
-    stmt->stmt.reset((StmtAST *)$5);
+    stmt->exp = (ExpAST *)$3;
+    stmt->stmt = (StmtAST *)$5;
     $$ = stmt;
   }
   ;
@@ -347,7 +309,7 @@ OtherStmt
 //                 | "break" ";"
 OtherStmt
   : BREAK ';' {
-    auto stmt = new StmtAST();
+    auto stmt = ast_arena.make<StmtAST>();
     stmt->tag = StmtAST::BREAK;
     $$ = stmt;
   }
@@ -356,7 +318,7 @@ OtherStmt
 //                 | "continue" ";"
 OtherStmt
   : CONTINUE ';' {
-    auto stmt = new StmtAST();
+    auto stmt = ast_arena.make<StmtAST>();
     stmt->tag = StmtAST::CONTINUE;
     $$ = stmt;
   }
@@ -366,28 +328,23 @@ OtherStmt
 ConstDecl
   : CONST BType ConstDefList ';'{
     auto const_decl = (ConstDeclAST *)$3;
-    const_decl->btype = unique_ptr<BTypeAST>((BTypeAST *)$2);
+    const_decl->btype = (BTypeAST *)$2;
     $$ = const_decl;
   }
   ;
 
 ConstDefList
-  : ConstDef ',' ConstDefList {
-    auto const_decl = new ConstDeclAST();
-    auto const_decl_2 = unique_ptr<ConstDeclAST>((ConstDeclAST *)$3);
-    const_decl->const_defs.emplace_back((ConstDefAST *)$1);
-    int n = const_decl_2->const_defs.size();
-    for(int i = 0; i < n; ++i){
-        const_decl->const_defs.emplace_back(const_decl_2->const_defs[i].release());
-    }
+  : ConstDefList ',' ConstDef {
+    auto const_decl = (ConstDeclAST *)$1;
+    const_decl->const_defs.push_back((ConstDefAST *)$3);
     $$ = const_decl;
   }
   ;
 
 ConstDefList
   : ConstDef {
-    auto const_decl = new ConstDeclAST();
-    const_decl->const_defs.emplace_back((ConstDefAST *)$1);
+    auto const_decl = ast_arena.make<ConstDeclAST>();
+    const_decl->const_defs.push_back((ConstDefAST *)$1);
     $$ = const_decl;
   }
   ;
@@ -396,28 +353,23 @@ ConstDefList
 VarDecl
   : BType VarDefList ';' {
     auto var_decl = (VarDeclAST *)$2;
-    var_decl->btype = unique_ptr<BTypeAST>((BTypeAST *) $1);
+    var_decl->btype = (BTypeAST *)$1;
     $$ = var_decl;
   }
   ;
 
 VarDefList
-  : VarDef ',' VarDefList {
-    auto var_decl = new VarDeclAST();
-    auto var_decl_2 = unique_ptr<VarDeclAST>((VarDeclAST *)$3);
-    var_decl->var_defs.emplace_back((VarDefAST *)$1);
-    int n = var_decl_2->var_defs.size();
-    for(int i = 0; i < n; ++i){
-        var_decl->var_defs.emplace_back(var_decl_2->var_defs[i].release());
-    }
+  : VarDefList ',' VarDef {
+    auto var_decl = (VarDeclAST *)$1;
+    var_decl->var_defs.push_back((VarDefAST *)$3);
     $$ = var_decl;
   }
   ;
 
 VarDefList
   : VarDef {
-    auto var_decl = new VarDeclAST();
-    var_decl->var_defs.emplace_back((VarDefAST *)$1);
+    auto var_decl = ast_arena.make<VarDeclAST>();
+    var_decl->var_defs.push_back((VarDefAST *)$1);
     $$ = var_decl;
   }
   ;
@@ -425,11 +377,11 @@ VarDefList
 // BType         ::= "int"|"void";
 BType
   : INT {
-    auto btype = new BTypeAST();
+    auto btype = ast_arena.make<BTypeAST>();
     btype->tag = BTypeAST::INT;
     $$ = btype;
   } | VOID {
-    auto btype = new BTypeAST();
+    auto btype = ast_arena.make<BTypeAST>();
     btype->tag = BTypeAST::VOID;
     $$ = btype;
   }
@@ -438,9 +390,9 @@ BType
 // ConstDef      ::= IDENT {"[" ConstExp "]"} "=" ConstInitVal;
 ConstDef
   : IDENT '=' ConstInitVal {
-    auto const_def = new ConstDefAST();
-    const_def->ident = *unique_ptr<string>($1);
-    const_def->const_init_val = unique_ptr<ConstInitValAST>((ConstInitValAST *)$3);
+    auto const_def = ast_arena.make<ConstDefAST>();
+    const_def->ident = $1;
+    const_def->const_init_val = (ConstInitValAST *)$3;
     $$ = const_def;
   }
   ;
@@ -449,13 +401,13 @@ ConstDef
 //                 | IDENT {"[" ConstExp "]"} "=" InitVal;
 VarDef
   : IDENT{
-    auto var_def = new VarDefAST();
-    var_def->ident = *unique_ptr<string>($1);
+    auto var_def = ast_arena.make<VarDefAST>();
+    var_def->ident = $1;
     $$ = var_def;
   } | IDENT '=' InitVal {
-    auto var_def = new VarDefAST();
-    var_def->ident = *unique_ptr<string>($1);
-    var_def->init_val = unique_ptr<InitValAST>((InitValAST *)$3);
+    auto var_def = ast_arena.make<VarDefAST>();
+    var_def->ident = $1;
+    var_def->init_val = (InitValAST *)$3;
     $$ = var_def;
   } 
   ;
@@ -463,11 +415,11 @@ VarDef
 // InitVal       ::= Exp | "{" [InitVal {"," InitVal}] "}";
 InitVal
   : Exp{
-    auto init_val = new InitValAST();
-    init_val->exp.reset((ExpAST *)$1);
+    auto init_val = ast_arena.make<InitValAST>();
+    init_val->exp = (ExpAST *)$1;
     $$ = init_val;
   } | '{' '}' {
-    auto init_val = new InitValAST();
+    auto init_val = ast_arena.make<InitValAST>();
     $$ = init_val;
   } | '{' InitValList '}' {
     $$ = $2;
@@ -475,7 +427,7 @@ InitVal
 
 InitValList
   : InitVal {
-    auto init_val = new InitValAST();
+    auto init_val = ast_arena.make<InitValAST>();
     $$ = init_val;
   } | InitValList ',' InitVal {
     auto init_val = (InitValAST *)$1;
@@ -486,11 +438,11 @@ InitValList
 // ConstInitVal  ::= ConstExp | "{" [ConstInitVal {"," ConstInitVal}] "}";
 ConstInitVal
   : ConstExp {
-    auto const_init_val = new ConstInitValAST();
-    const_init_val->const_exp = unique_ptr<ConstExpAST>((ConstExpAST *)$1);
+    auto const_init_val = ast_arena.make<ConstInitValAST>();
+    const_init_val->const_exp = (ConstExpAST *)$1;
     $$ = const_init_val;
   } |'{' '}' {
-    auto const_init_val = new ConstInitValAST();
+    auto const_init_val = ast_arena.make<ConstInitValAST>();
     $$ = const_init_val;
   } | '{' ConstInitValList '}' {
     $$ = $2;
@@ -499,7 +451,7 @@ ConstInitVal
 
 ConstInitValList
   : ConstInitVal {
-    auto init_val = new ConstInitValAST();
+    auto init_val = ast_arena.make<ConstInitValAST>();
     $$ = init_val;
   } | ConstInitValList ',' ConstInitVal {
     auto init_val = (ConstInitValAST *)$1;
@@ -510,8 +462,8 @@ ConstInitValList
 // LVal          ::= IDENT {"[" Exp "]"};
 LVal
   : IDENT {
-    auto lval = new LValAST();
-    lval->ident = *unique_ptr<string>($1);
+    auto lval = ast_arena.make<LValAST>();
+    lval->ident = $1;
     $$ = lval;
   }
   ;
@@ -519,8 +471,8 @@ LVal
 // ConstExp      ::= Exp;
 ConstExp
   : Exp {
-    auto const_exp = new ConstExpAST();
-    const_exp->exp = unique_ptr<ExpAST>((ExpAST *)$1);
+    auto const_exp = ast_arena.make<ConstExpAST>();
+    const_exp->exp = (ExpAST *)$1;
     $$ = const_exp;
   }
   ;
@@ -528,8 +480,8 @@ ConstExp
 // Exp           ::= LOrExp; 逻辑或
 Exp
   : LOrExp {
-    auto exp = new ExpAST();
-    exp->l_or_exp = unique_ptr<LOrExpAST>((LOrExpAST *)$1);
+    auto exp = ast_arena.make<ExpAST>();
+    exp->l_or_exp = (LOrExpAST *)$1;
     $$ = exp;
   }
   ;
@@ -537,16 +489,16 @@ Exp
 // PrimaryExp    ::= "(" Exp ")" | LVal | Number; 基本表达式
 PrimaryExp
   : '(' Exp ')' {
-    auto primary_exp = new PrimaryExpAST();
+    auto primary_exp = ast_arena.make<PrimaryExpAST>();
     primary_exp->tag = PrimaryExpAST::PARENTHESES;
-    primary_exp->exp =  unique_ptr<ExpAST>((ExpAST *)$2);
+    primary_exp->exp = (ExpAST *)$2;
     $$ = primary_exp;
   } 
   ;
 
 PrimaryExp 
   : Number {
-    auto primary_exp = new PrimaryExpAST();
+    auto primary_exp = ast_arena.make<PrimaryExpAST>();
     primary_exp->tag = PrimaryExpAST::NUMBER;
     primary_exp->number = $1;
     $$ = primary_exp;
@@ -555,9 +507,9 @@ PrimaryExp
 
 PrimaryExp 
   : LVal {
-    auto primary_exp = new PrimaryExpAST();
+    auto primary_exp = ast_arena.make<PrimaryExpAST>();
     primary_exp->tag = PrimaryExpAST::LVAL;
-    primary_exp->lval =  unique_ptr<LValAST>((LValAST *)$1);
+    primary_exp->lval = (LValAST *)$1;
     $$ = primary_exp;
   }
   ;
@@ -572,34 +524,34 @@ Number
 // UnaryExp      ::= PrimaryExp | IDENT "(" [FuncRParams] ")" | UnaryOp UnaryExp; 一元表达式
 UnaryExp
   : PrimaryExp {
-    auto unary_exp = new UnaryExpAST();
+    auto unary_exp = ast_arena.make<UnaryExpAST>();
     unary_exp->tag = UnaryExpAST::PRIMARY_EXP;
-    unary_exp->primary_exp = unique_ptr<PrimaryExpAST>((PrimaryExpAST *)$1);
+    unary_exp->primary_exp = (PrimaryExpAST *)$1;
     $$ = unary_exp;
   }
   ;
 
 UnaryExp
   : UnaryOp UnaryExp{
-    auto unary_exp = new UnaryExpAST();
+    auto unary_exp = ast_arena.make<UnaryExpAST>();
     unary_exp->tag = UnaryExpAST::OP_UNITARY_EXP;
     unary_exp->unary_op = $1;
-    unary_exp->unary_exp = unique_ptr<UnaryExpAST>((UnaryExpAST *)$2);
+    unary_exp->unary_exp = (UnaryExpAST *)$2;
     $$ = unary_exp;
   }
   ;
 
 UnaryExp
   : IDENT '(' ')' {
-    auto unary_exp = new UnaryExpAST();
+    auto unary_exp = ast_arena.make<UnaryExpAST>();
     unary_exp->tag = UnaryExpAST::FUNC_CALL;
-    unary_exp->ident = *unique_ptr<string>($1);
+    unary_exp->ident = $1;
     $$ = unary_exp;
   } | IDENT '(' FuncRParams ')' {
-    auto unary_exp = new UnaryExpAST();
+    auto unary_exp = ast_arena.make<UnaryExpAST>();
     unary_exp->tag = UnaryExpAST::FUNC_CALL;
-    unary_exp->ident = *unique_ptr<string>($1);
-    unary_exp->func_params.reset((FuncRParamsAST *)$3);
+    unary_exp->ident = $1;
+    unary_exp->func_params = (FuncRParamsAST *)$3;
     $$ = unary_exp;
   }
   ;
@@ -607,19 +559,19 @@ UnaryExp
 // MulExp        ::= UnaryExp | MulExp ("*" | "/" | "%") UnaryExp;
 MulExp
   : UnaryExp{
-    auto mul_exp = new MulExpAST();
+    auto mul_exp = ast_arena.make<MulExpAST>();
     mul_exp->tag = MulExpAST::UNARY_EXP;
-    mul_exp->unary_exp = unique_ptr<UnaryExpAST>((UnaryExpAST *)$1);
+    mul_exp->unary_exp = (UnaryExpAST *)$1;
     $$ = mul_exp;
   }
   ;
 
 MulExp
   : MulExp '*' UnaryExp{
-    auto mul_exp = new MulExpAST();
+    auto mul_exp = ast_arena.make<MulExpAST>();
     mul_exp->tag = MulExpAST::OP_MUL_EXP;
-    mul_exp->mul_exp_1 = unique_ptr<MulExpAST>((MulExpAST *)$1);
-    mul_exp->unary_exp_2 = unique_ptr<UnaryExpAST>((UnaryExpAST *)$3);
+    mul_exp->mul_exp_1 = (MulExpAST *)$1;
+    mul_exp->unary_exp_2 = (UnaryExpAST *)$3;
     mul_exp->mul_op = '*';
     $$ = mul_exp;
   }
@@ -627,20 +579,20 @@ MulExp
 
 MulExp
   : MulExp '/' UnaryExp{
-    auto mul_exp = new MulExpAST();
+    auto mul_exp = ast_arena.make<MulExpAST>();
     mul_exp->tag = MulExpAST::OP_MUL_EXP;
-    mul_exp->mul_exp_1 = unique_ptr<MulExpAST>((MulExpAST *)$1);
-    mul_exp->unary_exp_2 = unique_ptr<UnaryExpAST>((UnaryExpAST *)$3);
+    mul_exp->mul_exp_1 = (MulExpAST *)$1;
+    mul_exp->unary_exp_2 = (UnaryExpAST *)$3;
     mul_exp->mul_op = '/';
     $$ = mul_exp;
   }
   ;
 MulExp
   : MulExp '%' UnaryExp{
-    auto mul_exp = new MulExpAST();
+    auto mul_exp = ast_arena.make<MulExpAST>();
     mul_exp->tag = MulExpAST::OP_MUL_EXP;
-    mul_exp->mul_exp_1 = unique_ptr<MulExpAST>((MulExpAST *)$1);
-    mul_exp->unary_exp_2 = unique_ptr<UnaryExpAST>((UnaryExpAST *)$3);
+    mul_exp->mul_exp_1 = (MulExpAST *)$1;
+    mul_exp->unary_exp_2 = (UnaryExpAST *)$3;
     mul_exp->mul_op = '%';
     $$ = mul_exp;
   }
@@ -649,29 +601,29 @@ MulExp
 // AddExp        ::= MulExp | AddExp ("+" | "-") MulExp;
 AddExp 
   : MulExp {
-    auto add_exp = new AddExpAST();
+    auto add_exp = ast_arena.make<AddExpAST>();
     add_exp->tag = AddExpAST::MUL_EXP;
-    add_exp->mul_exp = unique_ptr<MulExpAST>((MulExpAST *)$1);
+    add_exp->mul_exp = (MulExpAST *)$1;
     $$ = add_exp;
   }
   ;
 
 AddExp 
   : AddExp '+' MulExp {
-    auto add_exp = new AddExpAST();
+    auto add_exp = ast_arena.make<AddExpAST>();
     add_exp->tag = AddExpAST::OP_ADD_EXP;
-    add_exp->add_exp_1 = unique_ptr<AddExpAST>((AddExpAST *)$1);
-    add_exp->mul_exp_2 = unique_ptr<MulExpAST>((MulExpAST *)$3);
+    add_exp->add_exp_1 = (AddExpAST *)$1;
+    add_exp->mul_exp_2 = (MulExpAST *)$3;
     add_exp->add_op = '+';
     $$ = add_exp;
   }
   ;
 AddExp 
   : AddExp '-' MulExp {
-    auto add_exp = new AddExpAST();
+    auto add_exp = ast_arena.make<AddExpAST>();
     add_exp->tag = AddExpAST::OP_ADD_EXP;
-    add_exp->add_exp_1 = unique_ptr<AddExpAST>((AddExpAST *)$1);
-    add_exp->mul_exp_2 = unique_ptr<MulExpAST>((MulExpAST *)$3);
+    add_exp->add_exp_1 = (AddExpAST *)$1;
+    add_exp->mul_exp_2 = (MulExpAST *)$3;
     add_exp->add_op = '-';
     $$ = add_exp;
   }
@@ -680,19 +632,19 @@ AddExp
 // RelExp        ::= AddExp | RelExp ("<" | ">" | "<=" | ">=") AddExp; 关系表达式
 RelExp 
   : AddExp{
-    auto rel_exp = new RelExpAST();
+    auto rel_exp = ast_arena.make<RelExpAST>();
     rel_exp->tag = RelExpAST::ADD_EXP;
-    rel_exp->add_exp = unique_ptr<AddExpAST>((AddExpAST *)$1);
+    rel_exp->add_exp = (AddExpAST *)$1;
     $$ = rel_exp;
   }
   ;
 
 RelExp 
   : RelExp '<' AddExp{
-    auto rel_exp = new RelExpAST();
+    auto rel_exp = ast_arena.make<RelExpAST>();
     rel_exp->tag = RelExpAST::OP_REL_EXP;
-    rel_exp->rel_exp_1 = unique_ptr<RelExpAST>((RelExpAST *)$1);
-    rel_exp->add_exp_2 = unique_ptr<AddExpAST>((AddExpAST *)$3);
+    rel_exp->rel_exp_1 = (RelExpAST *)$1;
+    rel_exp->add_exp_2 = (AddExpAST *)$3;
     rel_exp->rel_op[0] = '<';
     rel_exp->rel_op[1] = 0;
     $$ = rel_exp;
@@ -701,10 +653,10 @@ RelExp
 
 RelExp 
   : RelExp '>' AddExp{
-    auto rel_exp = new RelExpAST();
+    auto rel_exp = ast_arena.make<RelExpAST>();
     rel_exp->tag = RelExpAST::OP_REL_EXP;
-    rel_exp->rel_exp_1 = unique_ptr<RelExpAST>((RelExpAST *)$1);
-    rel_exp->add_exp_2 = unique_ptr<AddExpAST>((AddExpAST *)$3);
+    rel_exp->rel_exp_1 = (RelExpAST *)$1;
+    rel_exp->add_exp_2 = (AddExpAST *)$3;
     rel_exp->rel_op[0] = '>';
     rel_exp->rel_op[1] = 0;
     $$ = rel_exp;
@@ -712,10 +664,10 @@ RelExp
   ;
 RelExp 
   : RelExp LESS_EQ AddExp{
-    auto rel_exp = new RelExpAST();
+    auto rel_exp = ast_arena.make<RelExpAST>();
     rel_exp->tag = RelExpAST::OP_REL_EXP;
-    rel_exp->rel_exp_1 = unique_ptr<RelExpAST>((RelExpAST *)$1);
-    rel_exp->add_exp_2 = unique_ptr<AddExpAST>((AddExpAST *)$3);
+    rel_exp->rel_exp_1 = (RelExpAST *)$1;
+    rel_exp->add_exp_2 = (AddExpAST *)$3;
     rel_exp->rel_op[0] = '<';
     rel_exp->rel_op[1] = '=';
     $$ = rel_exp;
@@ -723,10 +675,10 @@ RelExp
   ;
 RelExp 
   : RelExp GREAT_EQ AddExp{
-    auto rel_exp = new RelExpAST();
+    auto rel_exp = ast_arena.make<RelExpAST>();
     rel_exp->tag = RelExpAST::OP_REL_EXP;
-    rel_exp->rel_exp_1 = unique_ptr<RelExpAST>((RelExpAST *)$1);
-    rel_exp->add_exp_2 = unique_ptr<AddExpAST>((AddExpAST *)$3);
+    rel_exp->rel_exp_1 = (RelExpAST *)$1;
+    rel_exp->add_exp_2 = (AddExpAST *)$3;
     rel_exp->rel_op[0] = '>';
     rel_exp->rel_op[1] = '=';
     $$ = rel_exp;
@@ -736,29 +688,29 @@ RelExp
 // EqExp         ::= RelExp | EqExp ("==" | "!=") RelExp; 相等性表达式
 EqExp 
   : RelExp{
-    auto eq_exp = new EqExpAST();
+    auto eq_exp = ast_arena.make<EqExpAST>();
     eq_exp->tag = EqExpAST::REL_EXP;
-    eq_exp->rel_exp = unique_ptr<RelExpAST>((RelExpAST *)$1);
+    eq_exp->rel_exp = (RelExpAST *)$1;
     $$ = eq_exp;
   }
   ;
 
 EqExp 
   : EqExp EQUAL RelExp{
-    auto eq_exp = new EqExpAST();
+    auto eq_exp = ast_arena.make<EqExpAST>();
     eq_exp->tag = EqExpAST::OP_EQ_EXP;
-    eq_exp->eq_exp_1 = unique_ptr<EqExpAST>((EqExpAST *)$1);
-    eq_exp->rel_exp_2 = unique_ptr<RelExpAST>((RelExpAST *)$3);
+    eq_exp->eq_exp_1 = (EqExpAST *)$1;
+    eq_exp->rel_exp_2 = (RelExpAST *)$3;
     eq_exp->eq_op = '=';
     $$ = eq_exp;
   }
   ;
 EqExp 
   : EqExp NOT_EQUAL RelExp{
-    auto eq_exp = new EqExpAST();
+    auto eq_exp = ast_arena.make<EqExpAST>();
     eq_exp->tag = EqExpAST::OP_EQ_EXP;
-    eq_exp->eq_exp_1 = unique_ptr<EqExpAST>((EqExpAST *)$1);
-    eq_exp->rel_exp_2 = unique_ptr<RelExpAST>((RelExpAST *)$3);
+    eq_exp->eq_exp_1 = (EqExpAST *)$1;
+    eq_exp->rel_exp_2 = (RelExpAST *)$3;
     eq_exp->eq_op = '!';
     $$ = eq_exp;
   }
@@ -767,34 +719,34 @@ EqExp
 // LAndExp       ::= EqExp | LAndExp "&&" EqExp;
 LAndExp
   : EqExp {
-    auto l_and_exp = new LAndExpAST();
+    auto l_and_exp = ast_arena.make<LAndExpAST>();
     l_and_exp->tag = LAndExpAST::EQ_EXP;
-    l_and_exp->eq_exp = unique_ptr<EqExpAST>((EqExpAST *)$1);
+    l_and_exp->eq_exp = (EqExpAST *)$1;
     $$ = l_and_exp;
   }
 LAndExp
   : LAndExp AND EqExp{
-    auto l_and_exp = new LAndExpAST();
+    auto l_and_exp = ast_arena.make<LAndExpAST>();
     l_and_exp->tag = LAndExpAST::OP_L_AND_EXP;
-    l_and_exp->l_and_exp_1 = unique_ptr<LAndExpAST>((LAndExpAST *)$1);
-    l_and_exp->eq_exp_2 = unique_ptr<EqExpAST>((EqExpAST *)$3);
+    l_and_exp->l_and_exp_1 = (LAndExpAST *)$1;
+    l_and_exp->eq_exp_2 = (EqExpAST *)$3;
     $$ = l_and_exp;
   }
 
 // LOrExp        ::= LAndExp | LOrExp "||" LAndExp;
 LOrExp
   : LAndExp {
-    auto l_or_exp = new LOrExpAST();
+    auto l_or_exp = ast_arena.make<LOrExpAST>();
     l_or_exp->tag = LOrExpAST::L_AND_EXP;
-    l_or_exp->l_and_exp = unique_ptr<LAndExpAST>((LAndExpAST *)$1);
+    l_or_exp->l_and_exp = (LAndExpAST *)$1;
     $$ = l_or_exp;
   }
 LOrExp
   : LOrExp OR LAndExp {
-    auto l_or_exp = new LOrExpAST();
+    auto l_or_exp = ast_arena.make<LOrExpAST>();
     l_or_exp->tag = LOrExpAST::OP_L_OR_EXP;
-    l_or_exp->l_or_exp_1 = unique_ptr<LOrExpAST>((LOrExpAST *)$1);
-    l_or_exp->l_and_exp_2 = unique_ptr<LAndExpAST>((LAndExpAST *)$3);
+    l_or_exp->l_or_exp_1 = (LOrExpAST *)$1;
+    l_or_exp->l_and_exp_2 = (LAndExpAST *)$3;
     $$ = l_or_exp;
   }
 
@@ -819,17 +771,12 @@ UnaryOp
 // FuncRParams   ::= Exp {"," Exp};
 FuncRParams
   : Exp {
-    auto params = new FuncRParamsAST();
-    params->exps.emplace_back((ExpAST *)$1);
+    auto params = ast_arena.make<FuncRParamsAST>();
+    params->exps.push_back((ExpAST *)$1);
     $$ = params;
-  } | Exp ',' FuncRParams {
-    auto params = new FuncRParamsAST();
-    params->exps.emplace_back((ExpAST *)$1);
-    auto p2 = unique_ptr<FuncRParamsAST>((FuncRParamsAST *)$3);
-    int n = p2->exps.size();
-    for(int i = 0; i < n; ++i){
-        params->exps.emplace_back(p2->exps[i].release());
-    }
+  } | FuncRParams ',' Exp {
+    auto params = (FuncRParamsAST *)$1;
+    params->exps.push_back((ExpAST *)$3);
     $$ = params;
   }
   ;
@@ -838,6 +785,6 @@ FuncRParams
 
 // 定义错误处理函数, 其中第二个参数是错误信息
 // parser 如果发生错误 (例如输入的程序出现了语法错误), 就会调用这个函数
-void yyerror(unique_ptr<BaseAST> &ast, const char *s) {
+void yyerror(BaseAST *&ast, const char *s) {
   cerr << "error: " << s << endl;
 }
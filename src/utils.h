@@ -4,100 +4,132 @@
 #include <set>
 #include <vector>
 #include <stack>
+#include "IR.h"
 
+// 在内存中直接构建 Koopa IR，接口与文本形式一一对应
 class KoopaIR{
 private:
-    std::string koopa_ir;
+    IRFunction *func = nullptr;     // 当前函数
+    IRBasicBlock *cur = nullptr;    // 当前基本块
+
+    IRValue *inst(IRValue::TAG tag, IRType *ty){
+        IRValue *v = func->newValue(tag, ty);
+        v->bb = cur;
+        cur->insts.push_back(v);
+        return v;
+    }
 public:
-    void append(const std::string &s){
-        koopa_ir += s;
+    IRProgram program;
+
+    IRValue *integer(int i){
+        return program.getInteger(i);
+    }
+
+    // 两个操作数都是常量时直接折叠成常量
+    IRValue *binary(IRValue::OP op, IRValue *s1, IRValue *s2){
+        int res;
+        if(s1->tag == IRValue::INTEGER && s2->tag == IRValue::INTEGER
+            && foldBinary(op, s1->value, s2->value, res))
+            return integer(res);
+        IRValue *v = inst(IRValue::BINARY, IRType::getInt32());
+        v->op = op;
+        v->ops = {s1, s2};
+        return v;
+    }
+
+    // 创建一个函数并作为当前函数，参数为 FUNC_ARG_REF
+    IRFunction *function(const std::string &name, const std::vector<IRType *> &params, IRType *ret){
+        func = program.newFunction(name, IRType::getFunction(params, ret));
+        for(size_t i = 0; i < params.size(); ++i){
+            IRValue *p = func->newValue(IRValue::FUNC_ARG_REF, params[i]);
+            p->value = i;
+            func->params.push_back(p);
+        }
+        return func;
     }
 
-    void binary(const std::string &op, const std::string &rd, const std::string &s1, const std::string &s2){
-        koopa_ir += "  " + rd + " = " + op + " " + s1 + ", " + s2 + "\n";
+    // 库函数等只有声明的函数
+    IRFunction *declare(const std::string &name, const std::vector<IRType *> &params, IRType *ret){
+        return program.newFunction(name, IRType::getFunction(params, ret));
     }
 
-    void label(const std::string &s){
-        koopa_ir += s + ":\n";
+    // 新建一个基本块，label 之后才加入函数
+    IRBasicBlock *block(const std::string &name){
+        return func->newBasicBlock(name);
     }
 
-    void ret(const std::string &name){
-        koopa_ir +="  ret " + name + "\n";
+    void label(IRBasicBlock *bb){
+        func->bbs.push_back(bb);
+        cur = bb;
     }
 
-    void alloc(const std::string &name){
-        koopa_ir += "  " + name + " = alloc i32\n";
+    // v 为 nullptr 时无返回值
+    void ret(IRValue *v){
+        IRValue *r = inst(IRValue::RETURN, IRType::getUnit());
+        if(v)
+            r->ops.push_back(v);
     }
 
-    void alloc(const std::string &name, const std::string &type_str){
-        koopa_ir += "  " + name + " = alloc " + type_str + "\n";
+    IRValue *alloc(const std::string &name = "", IRType *ty = IRType::getInt32()){
+        IRValue *v = inst(IRValue::ALLOC, IRType::getPointer(ty));
+        v->name = name;
+        return v;
     }
 
-    void globalAllocINT(const std::string &name, const std::string &init = "zeroinit"){
-        koopa_ir += "global " + name + " = alloc i32, " + init + "\n";
+    // init 为 nullptr 时零初始化
+    IRValue *globalAllocINT(IRValue *init = nullptr){
+        return globalAllocArray(IRType::getInt32(), init);
     }
 
-    void globalAllocArray(const std::string &name, const std::string &array_type, const std::string &init){
-        koopa_ir += "global " + name + " = alloc " + array_type + ", " + init + "\n";
+    IRValue *globalAllocArray(IRType *ty, IRValue *init){
+        IRValue *v = program.newValue(IRValue::GLOBAL_ALLOC, IRType::getPointer(ty));
+        v->ops.push_back(init ? init : program.getZeroInit(ty));
+        program.values.push_back(v);
+        return v;
     }
 
-    void load(const std::string & to, const std::string &from){
-        koopa_ir += "  " + to + " = load " + from + '\n';
+    IRValue *load(IRValue *from){
+        IRValue *v = inst(IRValue::LOAD, from->ty->base);
+        v->ops = {from};
+        return v;
     }
 
-    void store(const std::string &from, const std::string &to){
-        koopa_ir += "  store " + from + ", " + to + '\n';
+    void store(IRValue *from, IRValue *to){
+        IRValue *v = inst(IRValue::STORE, IRType::getUnit());
+        v->ops = {from, to};
     }
 
     // Branch ::= "br" Value "," SYMBOL "," SYMBOL;
-    void br(const std::string &v, const std::string &then_s, const std::string &else_s){
-        koopa_ir += "  br " + v + ", " + then_s + ", " + else_s + '\n';
+    void br(IRValue *v, IRBasicBlock *then_s, IRBasicBlock *else_s){
+        IRValue *b = inst(IRValue::BRANCH, IRType::getUnit());
+        b->ops = {v};
+        b->target[0] = then_s;
+        b->target[1] = else_s;
     }
-    
+
     // Jump ::= "jump" SYMBOL;
-    void jump(const std::string &label){
-        koopa_ir += "  jump " + label + '\n';
+    void jump(IRBasicBlock *target){
+        IRValue *j = inst(IRValue::JUMP, IRType::getUnit());
+        j->target[0] = target;
     }
 
     // FunCall ::= "call" SYMBOL "(" [Value {"," Value}] ")";
-    void call(const std::string &to, const std::string &func,const std::vector<std::string>& params){
-        if(to.length()){
-            koopa_ir += "  " + to + " = ";
-        }else{
-            koopa_ir += "  ";
-        }
-        koopa_ir += "call " + func +"(";
-        if(params.size()){
-            int n = params.size();
-            koopa_ir += params[0];
-            for(int i = 1; i < n; ++i){
-                koopa_ir += ", " + params[i];
-            }
-        }
-        koopa_ir += ")\n";
+    IRValue *call(IRFunction *f, const std::vector<IRValue *> &params){
+        IRValue *v = inst(IRValue::CALL, f->ty->base);
+        v->callee = f;
+        v->ops = params;
+        return v;
     }
 
-    void getelemptr(const std::string& to, const std::string &from, const int i){
-        koopa_ir += "  " + to + " = getelemptr " + from + ", " + std::to_string(i) + "\n";
+    IRValue *getelemptr(IRValue *from, const int i){
+        return getelemptr(from, integer(i));
     }
 
-    void getelemptr(const std::string& to, const std::string &from, const std::string& i){
-        koopa_ir += "  " + to + " = getelemptr " + from + ", " + i + "\n";
+    IRValue *getelemptr(IRValue *from, IRValue *i){
+        IRValue *v = inst(IRValue::GET_ELEM_PTR, IRType::getPointer(from->ty->base->base));
+        v->ops = {from, i};
+        return v;
     }
-
-    void declLibFunc(){
-        this->append("decl @getint(): i32\n");
-        this->append("decl @getch(): i32\n");
-        this->append("decl @getarray(*i32): i32\n");
-        this->append("decl @putint(i32)\n");
-        this->append("decl @putch(i32)\n");
-        this->append("decl @putarray(i32, *i32)\n");
-        this->append("decl @starttime()\n");
-        this->append("decl @stoptime()\n");
-        this->append("\n");
-    }
-
-    const char * c_str(){return koopa_ir.c_str();}
 };
 
 class BlockController{
@@ -119,15 +151,15 @@ public:
 
 class WhileName{
 public:
-    std::string entry_name, body_name, end_name;
-    WhileName(const std::string &_entry, const std::string & _body, const std::string &_end): entry_name(_entry), body_name(_body), end_name(_end){}
+    IRBasicBlock *entry_bb, *body_bb, *end_bb;
+    WhileName(IRBasicBlock *_entry, IRBasicBlock *_body, IRBasicBlock *_end): entry_bb(_entry), body_bb(_body), end_bb(_end){}
 };
 
 class WhileStack{
 private:
     std::stack<WhileName> whiles;
 public:
-    void append(const std::string &_entry, const std::string & _body, const std::string &_end){
+    void append(IRBasicBlock *_entry, IRBasicBlock *_body, IRBasicBlock *_end){
         whiles.emplace(_entry, _body, _end);
     }
     
@@ -135,15 +167,15 @@ public:
         whiles.pop();
     }
 
-    std::string getEntryName(){
-        return whiles.top().entry_name;
+    IRBasicBlock *getEntry(){
+        return whiles.top().entry_bb;
     }
 
-    std::string getBodyName(){
-        return whiles.top().body_name;
+    IRBasicBlock *getBody(){
+        return whiles.top().body_bb;
     }
 
-    std::string getEndName(){
-        return whiles.top().end_name;
+    IRBasicBlock *getEnd(){
+        return whiles.top().end_bb;
     }
 };
\ No newline at end of file
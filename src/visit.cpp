@@ -1,12 +1,17 @@
 #include "visit.h"
 #include "Symbol.h"
 #include "utils.h"
+#include "RegAlloc.h"
+#include "CFG.h"
 #include <cassert>
 #include <iostream>
 #include <cstring>
+#include <cstdint>
 #include <cstdlib>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <utility>
 using namespace std;
 
 const char* op2inst[] = {
@@ -17,27 +22,57 @@ const char* op2inst[] = {
 };
   
 // 配栈上局部变量的地址
+// 栈帧从低到高：A 调用参数 | S 局部变量和溢出的值 | C callee-saved 寄存器 | R ra
 class LocalVarAllocator{
 public:
-    unordered_map<koopa_raw_value_t, size_t> var_addr;    // 记录每个value的偏移量
+    vector<size_t> var_addr;    // 按值的编号记录每个value的偏移量
     // R: 函数中有call则为4，用于保存ra寄存器
     // A: 该函数调用的函数中，参数最多的那个，需要额外分配的第9,10……个参数的空间
     // S: 为这个函数的局部变量分配的栈空间
-    size_t R, A, S;
+    // C: 保存用到的 callee-saved 寄存器的空间
+    size_t R, A, S, C;
     size_t delta;   // 16字节对齐后的栈帧长度
-    LocalVarAllocator(): R(0), A(0), S(0){} 
+    LocalVarAllocator(): R(0), A(0), S(0), C(0){} 
 
-    void clear(){
-        var_addr.clear();
-        R = A = S = 0;
+    // n 为函数中值的个数
+    void clear(size_t n){
+        var_addr.assign(n, 0);
+        R = A = S = C = 0;
         delta = 0;
     }
 
-    void alloc(koopa_raw_value_t value, size_t width = 4){
-        var_addr.insert(make_pair(value, S));
+    void alloc(IRValue *value, size_t width = 4){
+        var_addr[value->id] = S;
         S += width;
     }
 
+    // 给溢出的值分配 4 字节的栈槽，和寄存器一样按活跃区间分配，区间不重叠的值共用栈槽
+    void allocSpills(const vector<RegisterAllocator::Range> &spills){
+        vector<pair<int, size_t>> active;   // 区间结束的位置，占用的栈槽
+        vector<size_t> free_slots;
+        for(auto &cur : spills){
+            for(size_t i = 0; i < active.size(); ){
+                if(active[i].first <= cur.start){
+                    free_slots.push_back(active[i].second);
+                    active[i] = active.back();
+                    active.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+            size_t slot;
+            if(free_slots.empty()){
+                slot = S;
+                S += 4;
+            } else {
+                slot = free_slots.back();
+                free_slots.pop_back();
+            }
+            var_addr[cur.value->id] = slot;
+            active.emplace_back(cur.end, slot);
+        }
+    }
+
     void setR(){
         R = 4;
     }
@@ -46,195 +81,588 @@ public:
         A = A > a ? A : a;
     }
 
-    bool exists(koopa_raw_value_t value){
-        return var_addr.find(value) != var_addr.end();
+    void setC(size_t c){
+        C = c;
     }
-    
-    size_t getOffset(koopa_raw_value_t value){
+
+    size_t getOffset(IRValue *value){
         // 大小为A的位置存函数参数
-        return var_addr[value] + A;
+        return var_addr[value->id] + A;
+    }
+
+    // 第 i 个 callee-saved 寄存器的保存位置
+    size_t getCalleeOffset(size_t i){
+        return A + S + 4 * i;
     }
 
     void getDelta(){
-        int d = S + R + A;
+        int d = S + R + A + C;
         delta = d%16 ? d + 16 - d %16: d;
     }
 };
 
-// 函数控制器，用于确定当前函数的参数是第几个
-class FunctionController{
+RiscvString rvs;
+LocalVarAllocator lva;
+TempLabelManager tlm;
+RegisterAllocator regs;
+// 条件跳转 op l, r，bnez/beqz 只有 l
+struct BranchMatch{
+    const char *op = nullptr;
+    IRValue *l = nullptr, *r = nullptr;
+};
+// 每条 br 匹配出的条件跳转，按 br 的编号索引，见 matchBranches
+vector<BranchMatch> branch_match;
+// 尾调用：块末尾的 call 和紧随其后返回它的结果的 ret，按值的编号索引
+// 恢复栈帧之后用 tail 跳到被调用的函数，由它直接返回到调用者
+vector<bool> tail_call;
+// 当前函数中排在正在生成的块后面的块，跳到它可以不用 j
+IRBasicBlock *next_bb = nullptr;
+// 正在生成的块是否已经建立了栈帧，见 frameBlocks
+bool frame_active = true;
+// 需要栈帧、又有不需要栈帧的前驱的块，从这些前驱跳过来时先经过这个标号建立栈帧
+unordered_map<IRBasicBlock *, string> prologue_label;
+// 多个 ret 共用的 epilogue 的标号，为空时每个 ret 各自恢复栈帧
+string epilogue_label;
+// 各个 ret 重复的 epilogue 指令数超过它时才共用一份
+const size_t MAX_EPILOGUE_COPY = 8;
+
+// 比较运算对应的条件跳转指令，negate 为 true 时取反
+static const char *cmpBranch(IRValue::OP op, bool negate){
+    switch(op){
+        case IRValue::OP_EQ: return negate ? "bne" : "beq";
+        case IRValue::OP_NOT_EQ: return negate ? "beq" : "bne";
+        case IRValue::OP_LT: return negate ? "bge" : "blt";
+        case IRValue::OP_GT: return negate ? "ble" : "bgt";
+        case IRValue::OP_LE: return negate ? "bgt" : "ble";
+        case IRValue::OP_GE: return negate ? "blt" : "bge";
+        default: return nullptr;
+    }
+}
+
+static bool isCmp(IRValue *v){
+    return v->tag == IRValue::BINARY && cmpBranch(v->op, false) != nullptr;
+}
+
+// 在 br 的条件的表达式树上自顶向下匹配，得到一条条件跳转
+//   cmp a, b               => b<cc> a, b
+//   eq/ne (cmp a, b), 0    => 对里面的比较匹配，eq 时条件取反，可以多层嵌套（!(a < b) 等）
+//   其他                   => bnez/beqz cond
+// 匹配进条件跳转的比较只被上一层使用，标记为 folded，不再单独计算和分配寄存器，
+// 它们的操作数的活跃区间延长到 br
+static BranchMatch matchCond(IRValue *cond, const vector<int> &uses, bool negate){
+    if(!isCmp(cond) || uses[cond->id] != 1)
+        return BranchMatch{negate ? "beqz" : "bnez", cond, nullptr};
+    regs.folded[cond->id] = true;
+    IRValue *a = cond->ops[0], *b = cond->ops[1];
+    if(cond->op == IRValue::OP_EQ || cond->op == IRValue::OP_NOT_EQ){
+        if(a->tag == IRValue::INTEGER && a->value == 0)
+            swap(a, b);
+        if(b->tag == IRValue::INTEGER && b->value == 0 && isCmp(a) && uses[a->id] == 1)
+            return matchCond(a, uses, negate != (cond->op == IRValue::OP_EQ));
+    }
+    return BranchMatch{cmpBranch(cond->op, negate), cond->ops[0], cond->ops[1]};
+}
+
+// 给每条 br 匹配条件跳转，在分配寄存器之前进行
+static void matchBranches(IRFunction *func, size_t values){
+    branch_match.assign(values, BranchMatch{});
+    vector<int> uses(values, 0);
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            for(auto op : v->ops){
+                if(op->id >= 0)
+                    ++uses[op->id];
+            }
+        }
+    }
+    for(auto bb : func->bbs){
+        IRValue *br = bb->insts.back();
+        if(br->tag == IRValue::BRANCH && br->ops[0]->id >= 0)
+            branch_match[br->id] = matchCond(br->ops[0], uses, false);
+    }
+}
+
+// 找出可以复用当前栈帧的尾调用
+// 栈上传递的参数放在调用者为当前函数准备的位置，不能比当前函数收到的多；
+// 实参不能指向当前函数的栈帧（见 mayPointToFrame），这些空间在跳过去之前就释放了
+static void findTailCalls(IRFunction *func, size_t values){
+    tail_call.assign(values, false);
+    for(auto bb : func->bbs){
+        size_t n = bb->insts.size();
+        if(n < 2)
+            continue;
+        IRValue *call = bb->insts[n - 2], *ret = bb->insts[n - 1];
+        if(call->tag != IRValue::CALL || ret->tag != IRValue::RETURN)
+            continue;
+        if(!ret->ops.empty() && ret->ops[0] != call)
+            continue;
+        if(call->ops.size() > max((size_t)8, func->params.size()))
+            continue;
+        bool ok = true;
+        for(auto arg : call->ops)
+            ok &= !mayPointToFrame(arg);
+        if(ok)
+            tail_call[call->id] = tail_call[ret->id] = true;
+    }
+}
+
+// 找出在使用处展开计算的地址：getelemptr/getptr 的基址是 alloc、全局变量或者同样展开的地址，
+// 只被 load/store 当作地址、被 getelemptr/getptr 当作基址使用，
+// 并且下标是常量（展开后只是一个偏移量），或者只有一个使用者（多维数组的下标链合并到最后一次计算）
+static void findFoldedAddress(IRFunction *func, size_t values){
+    regs.folded.assign(values, false);
+    auto isAddr = [](IRValue *v){
+        return v->tag == IRValue::GET_ELEM_PTR || v->tag == IRValue::GET_PTR;
+    };
+    vector<vector<pair<IRValue *, size_t>>> users(values);
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            for(size_t i = 0; i < v->ops.size(); ++i){
+                if(isAddr(v->ops[i]))
+                    users[v->ops[i]->id].emplace_back(v, i);
+            }
+        }
+    }
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            if(!isAddr(v))
+                continue;
+            IRValue *src = v->ops[0];
+            if(src->tag != IRValue::ALLOC && src->tag != IRValue::GLOBAL_ALLOC && !regs.isFolded(src))
+                continue;
+            auto &us = users[v->id];
+            bool ok = !us.empty() && (v->ops[1]->tag == IRValue::INTEGER || us.size() == 1);
+            for(auto &u : us){
+                IRValue *user = u.first;
+                ok = ok && ((user->tag == IRValue::LOAD && u.second == 0)
+                    || (user->tag == IRValue::STORE && u.second == 1) || (isAddr(user) && u.second == 0));
+            }
+            if(ok)
+                regs.folded[v->id] = true;
+        }
+    }
+}
+
+// 去掉 @/% 前缀的汇编符号名
+static string_view symbolName(const string &name){
+    return string_view(name).substr(1);
+}
+
+// 基本块的汇编标号，加上 .L 前缀，不会和 SysY 的函数名、全局变量名重复
+static string blockName(IRBasicBlock *bb){
+    return ".L" + string(symbolName(bb->name));
+}
+
+// 值是否要用到栈帧：局部变量的地址，溢出到栈上或者放在 callee-saved 寄存器中的值
+// 在使用处展开的值看它的操作数
+static bool usesFrame(IRValue *v){
+    if(v->tag == IRValue::ALLOC)
+        return true;
+    if(regs.isFolded(v)){
+        for(auto op : v->ops){
+            if(usesFrame(op))
+                return true;
+        }
+        return false;
+    }
+    bool vreg = v->tag == IRValue::FUNC_ARG_REF || v->tag == IRValue::BLOCK_ARG_REF
+        || (v->isInst() && v->hasResult());
+    return vreg && v->id >= 0 && (!regs.inReg(v) || regs.getReg(v)[0] == 's');
+}
+
+// 基本块是否需要栈帧：有 call（尾调用除外）、定义或使用了 usesFrame 的值，包括传给后继的块参数
+static bool needsFrame(IRBasicBlock *bb){
+    for(auto p : bb->params){
+        if(usesFrame(p))
+            return true;
+    }
+    for(auto v : bb->insts){
+        if(v->tag == IRValue::CALL && !tail_call[v->id])
+            return true;
+        if(!regs.isFolded(v) && usesFrame(v))
+            return true;
+        for(auto op : v->ops){
+            if(usesFrame(op))
+                return true;
+        }
+        for(int t = 0; t < 2; ++t){
+            if(v->target[t] == nullptr)
+                continue;
+            for(auto p : v->target[t]->params){
+                if(usesFrame(p))
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+/*
+收缩包装：只在需要栈帧的路径上建立栈帧，按 func->bbs 的顺序返回每个块是否在栈帧中
+需要栈帧的块（needsFrame）和从它们可达的块都在栈帧中，其余的块不建立栈帧，其中的 ret 直接返回
+入口块在栈帧中（包括参数要放到 s 寄存器或栈上）时整个函数都在栈帧中，和原来一样
+从不在栈帧中的块跳到在栈帧中的块时先经过 prologue_label，见 Visit(IRFunction *)
+*/
+static vector<bool> frameBlocks(IRFunction *func){
+    vector<bool> res(func->bbs.size(), true);
+    if(!lva.delta || func->params.size() > 8)
+        return res;
+    for(auto p : func->params){
+        if(usesFrame(p))
+            return res;
+    }
+    CFG cfg(func);
+    vector<bool> in(cfg.size(), false);
+    vector<int> work;
+    for(size_t b = 0; b < cfg.size(); ++b){
+        if(needsFrame(cfg.rpo[b])){
+            in[b] = true;
+            work.push_back(b);
+        }
+    }
+    while(!work.empty()){
+        int b = work.back();
+        work.pop_back();
+        for(int s : cfg.succs[b]){
+            if(!in[s]){
+                in[s] = true;
+                work.push_back(s);
+            }
+        }
+    }
+    if(in[0])
+        return res;
+    for(size_t i = 0; i < func->bbs.size(); ++i){
+        auto it = cfg.index.find(func->bbs[i]);
+        if(it != cfg.index.end())
+            res[i] = in[it->second];
+    }
+    return res;
+}
+
+// 跳转到 bb 时的标号，当前块没有建立栈帧、bb 需要栈帧时先建立栈帧
+static string blockLabel(IRBasicBlock *bb){
+    if(!frame_active){
+        auto it = prologue_label.find(bb);
+        if(it != prologue_label.end())
+            return it->second;
+    }
+    return blockName(bb);
+}
+
+// 把值 v 放到寄存器 rd 中
+static void loadValue(IRValue *v, const string &rd){
+    if(v->tag == IRValue::INTEGER){
+        rvs.li(rd, v->value);
+    } else if(v->tag == IRValue::GLOBAL_ALLOC){
+        rvs.la(rd, symbolName(v->name));
+    } else if(v->tag == IRValue::ALLOC){
+        // 栈上就是要找的地址
+        int offset = lva.getOffset(v);
+        if(rvs.immediate(offset)){
+            rvs.binary("addi", rd, "sp", offset);
+        } else {
+            rvs.li(rd, offset);
+            rvs.binary("add", rd, "sp", rd);
+        }
+    } else if(regs.inReg(v)){
+        if(rd != regs.getReg(v))
+            rvs.mov(regs.getReg(v), rd);
+    } else {
+        rvs.load(rd, "sp", lva.getOffset(v));
+    }
+}
+
+// 取得保存值 v 的寄存器，v 不在寄存器中时加载到 tmp
+static string getReg(IRValue *v, const string &tmp){
+    if(v->tag == IRValue::INTEGER && v->value == 0)
+        return "x0";
+    if(regs.inReg(v))
+        return regs.getReg(v);
+    loadValue(v, tmp);
+    return tmp;
+}
+
+// 指令结果写入的寄存器，溢出的值先算到 tmp 中再用 saveDef 写回栈上
+static string defReg(IRValue *v, const string &tmp){
+    return regs.inReg(v) ? regs.getReg(v) : tmp;
+}
+
+static void saveDef(IRValue *v, const string &reg){
+    if(!regs.inReg(v))
+        rvs.store(reg, "sp", lva.getOffset(v));
+}
+
+// 值的位置：寄存器或栈上的偏移
+struct Location{
+    string reg;     // 为空表示在栈上
+    int offset;
+    bool operator==(const Location &o) const {
+        return reg == o.reg && (!reg.empty() || offset == o.offset);
+    }
+};
+
+static Location regLoc(const string &reg){
+    return Location{reg, 0};
+}
+
+static Location stackLoc(int offset){
+    return Location{"", offset};
+}
+
+// 函数参数、块参数等被分配的值所在的位置
+static Location locate(IRValue *v){
+    return regs.inReg(v) ? regLoc(regs.getReg(v)) : stackLoc(lva.getOffset(v));
+}
+
+/*
+并行赋值，用于调用时传参和函数入口处取参数
+所有源操作数都要在被覆盖之前读出：每次输出一个目标不再被读的赋值，
+只剩下环时把环上一个位置的值暂存到 t2 打破环
+常量和地址不占位置，最后再写入
+*/
+class ParallelMove{
 private:
-    koopa_raw_function_t func;  //当前访问的函数
+    struct Move{
+        Location dst, src;
+        IRValue *value;     // 不为空时 src 无效，直接把值算到 dst
+    };
+    vector<Move> moves;
+
+    static void emitMove(const Location &dst, const Location &src){
+        if(dst == src)
+            return;
+        if(!dst.reg.empty() && !src.reg.empty()){
+            rvs.mov(src.reg, dst.reg);
+        } else if(!dst.reg.empty()){
+            rvs.load(dst.reg, "sp", src.offset);
+        } else if(!src.reg.empty()){
+            rvs.store(src.reg, "sp", dst.offset);
+        } else {
+            rvs.load("t1", "sp", src.offset);
+            rvs.store("t1", "sp", dst.offset);
+        }
+    }
 public:
-    FunctionController() = default;
-    void setFunc(koopa_raw_function_t f){
-        func = f;
-    }
-    int getParamNum(koopa_raw_value_t v){
-        int i = 0;
-        for(; i < func->params.len; ++i){
-            if(func->params.buffer[i] == (void *)v)
-                break;
+    void add(const Location &dst, const Location &src){
+        moves.push_back(Move{dst, src, nullptr});
+    }
+
+    void add(const Location &dst, IRValue *v){
+        if(regs.inReg(v))
+            add(dst, regLoc(regs.getReg(v)));
+        else if(v->tag == IRValue::INTEGER || v->tag == IRValue::GLOBAL_ALLOC || v->tag == IRValue::ALLOC)
+            moves.push_back(Move{dst, Location(), v});
+        else
+            add(dst, stackLoc(lva.getOffset(v)));
+    }
+
+    void emit(){
+        vector<Move> pending, consts;
+        for(auto &m : moves){
+            if(m.value)
+                consts.push_back(m);
+            else if(!(m.dst == m.src))
+                pending.push_back(m);
         }
-        return i;
+        while(!pending.empty()){
+            bool progress = false;
+            for(size_t i = 0; i < pending.size(); ){
+                bool read = false;
+                for(auto &o : pending){
+                    if(&o != &pending[i] && o.src == pending[i].dst){
+                        read = true;
+                        break;
+                    }
+                }
+                if(read){
+                    ++i;
+                    continue;
+                }
+                emitMove(pending[i].dst, pending[i].src);
+                pending.erase(pending.begin() + i);
+                progress = true;
+            }
+            if(!progress){
+                // 剩下的都在环上
+                Location d = pending[0].dst;
+                emitMove(regLoc("t2"), d);
+                for(auto &o : pending){
+                    if(o.src == d)
+                        o.src = regLoc("t2");
+                }
+            }
+        }
+        for(auto &m : consts){
+            if(!m.dst.reg.empty()){
+                loadValue(m.value, m.dst.reg);
+            } else {
+                loadValue(m.value, "t1");
+                rvs.store("t1", "sp", m.dst.offset);
+            }
+        }
+        moves.clear();
     }
 };
 
-RiscvString rvs;
-LocalVarAllocator lva;
-FunctionController fc;
-TempLabelManager tlm;
-
-// 访问 raw program
-void Visit(const koopa_raw_program_t &program) {
-    // 执行一些其他的必要操作
-    
+// 访问 program
+void Visit(const IRProgram &program) {
     // 访问所有全局变量
-    Visit(program.values);
+    for(auto value : program.values)
+        VisitGlobalVar(value);
     // 访问所有函数
-    Visit(program.funcs);
-}
-
-// 访问 raw slice
-void Visit(const koopa_raw_slice_t &slice) {
-    for (size_t i = 0; i < slice.len; ++i) {
-        auto ptr = slice.buffer[i];
-        // 根据 slice 的 kind 决定将 ptr 视作何种元素
-        switch (slice.kind) {
-        case KOOPA_RSIK_FUNCTION:
-            // 访问函数
-            Visit(reinterpret_cast<koopa_raw_function_t>(ptr));
-            break;
-        case KOOPA_RSIK_BASIC_BLOCK:
-            // 访问基本块
-            Visit(reinterpret_cast<koopa_raw_basic_block_t>(ptr));
-            break;
-        case KOOPA_RSIK_VALUE:
-            // 访问指令/全局变量
-            Visit(reinterpret_cast<koopa_raw_value_t>(ptr));
-            break;
-        default:
-            // 我们暂时不会遇到其他内容, 于是不对其做任何处理
-            assert(false);
-        }
-    }
+    for(auto func : program.funcs)
+        Visit(func);
 }
 
 // 访问函数
-void Visit(const koopa_raw_function_t &func) {
-    if(func->bbs.len == 0) return;
-    fc.setFunc(func);
+void Visit(IRFunction *func) {
+    if(func->isDecl()) return;
+    string_view name = symbolName(func->name);
 
-    rvs.append("  .text\n");
-    rvs.append("  .globl " + string(func->name + 1) + "\n");
-    rvs.append(string(func->name + 1)+ ":\n");
+    rvs.section(".text", name);
 
-    lva.clear();
-    // 先扫一遍完成局部变量分配
+    // 后端按编号在数组中记录每个值的信息
+    size_t values = func->numberValues();
+    lva.clear(values);
+    // 先分配寄存器，再给溢出的值和局部变量分配栈空间
+    findFoldedAddress(func, values);
+    matchBranches(func, values);
+    regs.run(func, values);
+    findTailCalls(func, values);
     allocLocal(func);
+    lva.setC(4 * regs.usedCalleeSaved().size());
     lva.getDelta();
 
-    //  函数的 prologue
-    if(lva.delta)
-        rvs.sp(-(int)lva.delta);
-    if(lva.R){
-        rvs.store("ra", "sp", (int)lva.delta - 4);
+    // 不需要栈帧的块排在前面时，prologue 推迟到进入需要栈帧的块之前
+    vector<bool> in_frame = frameBlocks(func);
+    unordered_map<IRBasicBlock *, size_t> pos;
+    for(size_t i = 0; i < func->bbs.size(); ++i)
+        pos[func->bbs[i]] = i;
+    prologue_label.clear();
+    for(size_t i = 0; i < func->bbs.size(); ++i){
+        if(in_frame[i])
+            continue;
+        for(auto succ : CFG::successors(func->bbs[i])){
+            if(in_frame[pos[succ]] && !prologue_label.count(succ))
+                prologue_label[succ] = tlm.getTmpLabel();
+        }
     }
+    frame_active = in_frame[0];
+    if(frame_active)
+        prologue();
 
+    // 参数从 a0 ~ a7 和 caller 栈帧中移到分配的位置
+    ParallelMove pm;
+    for(size_t i = 0; i < func->params.size(); ++i){
+        IRValue *p = func->params[i];
+        Location src = i < 8 ? regLoc("a" + to_string(i)) : stackLoc(lva.delta + (i - 8) * 4);
+        pm.add(locate(p), src);
+    }
+    pm.emit();
 
-    // 找到entry block
-    size_t e = 0;
-    for(e = 0; e < func->bbs.len; ++e){
-        auto ptr = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[e]);
-        if(ptr->name && !strcmp(ptr->name, "%entry")){
-            break;
+    // 栈帧中的 ret 各自恢复栈帧时重复的指令超过 MAX_EPILOGUE_COPY 条，就共用一份放在函数的最后，
+    // 每个 ret 多一次跳转，排在最后的 ret 由窥孔优化去掉跳转
+    size_t rets = 0;
+    for(size_t i = 0; i < func->bbs.size(); ++i){
+        IRValue *term = func->bbs[i]->insts.back();
+        rets += in_frame[i] && term->tag == IRValue::RETURN && !tail_call[term->id];
+    }
+    size_t len = regs.usedCalleeSaved().size() + (lva.R ? 1 : 0) + (lva.delta ? 1 : 0);
+    epilogue_label = rets > 1 && (rets - 1) * len > MAX_EPILOGUE_COPY ? tlm.getTmpLabel() : "";
+
+    // 第一个基本块就是 entry block
+    for(size_t i = 0; i < func->bbs.size(); ++i){
+        IRBasicBlock *bb = func->bbs[i];
+        next_bb = i + 1 < func->bbs.size() ? func->bbs[i + 1] : nullptr;
+        // 栈帧中的块不能落到后面块的 prologue 中
+        if(in_frame[i] && prologue_label.count(next_bb))
+            next_bb = nullptr;
+        frame_active = in_frame[i];
+        auto it = prologue_label.find(bb);
+        if(it != prologue_label.end()){
+            rvs.label(it->second);
+            prologue();
         }
+        Visit(bb);
     }
-    // 访问 entry block
-    Visit(reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[e]));
+    frame_active = true;
 
-    for(size_t i = 0; i < func->bbs.len; ++i){
-        if(i == e) continue;
-        auto ptr = func->bbs.buffer[i];
-        Visit(reinterpret_cast<koopa_raw_basic_block_t>(ptr));
+    if(!epilogue_label.empty()){
+        rvs.label(epilogue_label);
+        epilogue();
+        rvs.ret();
     }
 
-    // 函数的 epilogue 在ret指令完成
     rvs.append("\n\n");
+    rvs.endFunction();
 }
 
-// 访问基本块
-void Visit(const koopa_raw_basic_block_t &bb) {
-    if(bb->name && strcmp(bb->name, "%entry")){
-        rvs.label(string(bb->name + 1));
+// 分配栈帧，保存 ra 和用到的 callee-saved 寄存器
+void prologue(){
+    if(lva.delta)
+        rvs.sp(-(int)lva.delta);
+    if(lva.R){
+        rvs.store("ra", "sp", (int)lva.delta - 4);
     }
-    for(size_t i = 0; i < bb->insts.len; ++i){
-        auto ptr = bb->insts.buffer[i];
-        Visit(reinterpret_cast<koopa_raw_value_t>(ptr));
+    auto &saved = regs.usedCalleeSaved();
+    for(size_t i = 0; i < saved.size(); ++i)
+        rvs.store(saved[i], "sp", lva.getCalleeOffset(i));
+}
+
+// 访问基本块
+void Visit(IRBasicBlock *bb) {
+    if(bb->name != "%entry"){
+        rvs.label(blockName(bb));
     }
+    for(auto inst : bb->insts)
+        Visit(inst);
 }
 
 // 访问指令
-void Visit(const koopa_raw_value_t &value) {
+void Visit(IRValue *value) {
     // 根据指令类型判断后续需要如何访问
-    const auto &kind = value->kind;
-
-    switch (kind.tag) {
-        case KOOPA_RVT_RETURN:
+    switch (value->tag) {
+        case IRValue::RETURN:
             // 访问 return 指令
-            Visit(kind.data.ret);
-            break;
-        case KOOPA_RVT_INTEGER:
-            // 访问 integer 指令
-            rvs.append("Control flow should never reach here.\n");
-            Visit(kind.data.integer);
+            VisitReturn(value);
             break;
-        case KOOPA_RVT_BINARY:
+        case IRValue::BINARY:
             // 访问二元运算
-            Visit(kind.data.binary);
-            rvs.store("t0", "sp", lva.getOffset(value));
+            VisitBinary(value);
             break;
-        case KOOPA_RVT_ALLOC:
+        case IRValue::ALLOC:
             // 访问栈分配指令，啥都不用管
             break;
         
-        case KOOPA_RVT_LOAD:
+        case IRValue::LOAD:
             // 加载指令
-            Visit(kind.data.load);
-            rvs.store("t0", "sp", lva.getOffset(value));
+            VisitLoad(value);
             break;
 
-        case KOOPA_RVT_STORE:
+        case IRValue::STORE:
             // 存储指令
-            Visit(kind.data.store);
+            VisitStore(value);
             break;
-        case KOOPA_RVT_BRANCH:
+        case IRValue::BRANCH:
             // 条件分支指令
-            Visit(kind.data.branch);
+            VisitBranch(value);
             break;
-        case KOOPA_RVT_JUMP:
+        case IRValue::JUMP:
             // 无条件跳转指令
-            Visit(kind.data.jump);
+            VisitJump(value);
             break;
-        case KOOPA_RVT_CALL:
+        case IRValue::CALL:
             // 访问函数调用
-            Visit(kind.data.call);
-            if(kind.data.call.callee->ty->data.function.ret->tag == KOOPA_RTT_INT32){
-                rvs.store("a0", "sp", lva.getOffset(value));
-            }
-            break;
-        case KOOPA_RVT_GLOBAL_ALLOC:
-            // 访问全局变量
-            VisitGlobalVar(value);
+            VisitCall(value);
             break;
-        case KOOPA_RVT_GET_ELEM_PTR:
+        case IRValue::GET_ELEM_PTR:
             // 访问getelemptr指令
-            Visit(kind.data.get_elem_ptr);
-            rvs.store("t0", "sp", lva.getOffset(value));
+            VisitGetElemPtr(value);
+            break;
+        case IRValue::GET_PTR:
+            VisitGetPtr(value);
             break;
-        case KOOPA_RVT_GET_PTR:
-            Visit(kind.data.get_ptr);
-            rvs.store("t0", "sp", lva.getOffset(value));
         default:
             // 其他类型暂时遇不到
             break;
@@ -242,347 +670,462 @@ void Visit(const koopa_raw_value_t &value) {
 }
 
 // 访问return指令
-void Visit(const koopa_raw_return_t &value) {
-    if(value.value != nullptr) {
-        koopa_raw_value_t ret_value = value.value;
-        // 特判return一个整数情况
-        if(ret_value->kind.tag == KOOPA_RVT_INTEGER){
-            int i = Visit(ret_value->kind.data.integer);
-            rvs.li("a0", i);
-        } else{
-            int i = lva.getOffset(ret_value);
-            rvs.load("a0", "sp", i);
-        }
+void VisitReturn(IRValue *ret) {
+    // 尾调用已经完成了返回
+    if(tail_call[ret->id])
+        return;
+    if(!ret->ops.empty()) {
+        loadValue(ret->ops[0], "a0");
+    }
+    if(frame_active && !epilogue_label.empty()){
+        rvs.jump(epilogue_label);
+        return;
     }
+    epilogue();
+    rvs.ret();
+}
+
+// 恢复 callee-saved 寄存器、ra 和 sp，没有建立栈帧的块中什么都不做
+void epilogue(){
+    if(!frame_active)
+        return;
+    auto &saved = regs.usedCalleeSaved();
+    for(size_t i = 0; i < saved.size(); ++i)
+        rvs.load(saved[i], "sp", lva.getCalleeOffset(i));
     if(lva.R){
         rvs.load("ra", "sp", lva.delta - 4);
     }
     if(lva.delta)
         rvs.sp(lva.delta);
-    rvs.ret();
 }
 
-// 访问koopa_raw_integer_t,结果返回数值
-int Visit(const koopa_raw_integer_t &value){
-    return value.value;
+// 有符号除以常量 d 的魔数 m 和移位量 s，q = (mulh(x, m) [+ x]) >> s，再加上 x 的符号位修正
+// d >= 3 且不是 2 的幂，见 Hacker's Delight 10-1
+static void divMagic(int d, int &m, int &s){
+    const uint32_t two31 = 0x80000000u;
+    uint32_t ad = d, anc = two31 - 1 - two31 % ad;
+    uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad, delta;
+    int p = 31;
+    do{
+        ++p;
+        q1 *= 2, r1 *= 2;
+        if(r1 >= anc)
+            ++q1, r1 -= anc;
+        q2 *= 2, r2 *= 2;
+        if(r2 >= ad)
+            ++q2, r2 -= ad;
+        delta = ad - r2;
+    } while(q1 < delta || (q1 == delta && r1 == 0));
+    m = (int)(q2 + 1);
+    s = p - 32;
 }
 
-// 访问koopa_raw_binary_t
-void  Visit(const koopa_raw_binary_t &value){
+// x 乘以常量 c，2 的幂和 2^k ± 1 用移位和加减，中间结果放在 t2，否则返回 false 仍用 mul
+static bool mulConst(const string &rd, const string &x, int c){
+    uint32_t uc = c;
+    if(c == 0){
+        rvs.li(rd, 0);
+    } else if(c == 1){
+        rvs.mov(x, rd);
+    } else if(c == -1){
+        rvs.binary("sub", rd, "x0", x);
+    } else if((uc & (uc - 1)) == 0){
+        rvs.binary("slli", rd, x, __builtin_ctz(uc));
+    } else if(c < 0 && ((-uc) & (-uc - 1)) == 0){
+        rvs.binary("slli", "t2", x, __builtin_ctz(-uc));
+        rvs.binary("sub", rd, "x0", "t2");
+    } else if(c > 0 && ((uc - 1) & (uc - 2)) == 0){
+        rvs.binary("slli", "t2", x, __builtin_ctz(uc - 1));
+        rvs.binary("add", rd, "t2", x);
+    } else if(c > 0 && ((uc + 1) & uc) == 0){
+        rvs.binary("slli", "t2", x, __builtin_ctz(uc + 1));
+        rvs.binary("sub", rd, "t2", x);
+    } else {
+        return false;
+    }
+    return true;
+}
 
-    // 把左右操作数加载到t0,t1寄存器
-    koopa_raw_value_t l = value.lhs, r = value.rhs;
-    int i;
-    if(l->kind.tag == KOOPA_RVT_INTEGER){
-        i = Visit(l->kind.data.integer);
-        rvs.li("t0", i);
-    }else{
-        i = lva.getOffset(l);
-        rvs.load("t0", "sp", i);
+// x 除以常量 d（不为 0），mod 为 true 时求余数，结果与 div/rem 相同，中间结果放在 t1、t2
+// 2 的幂：负数先加上 |d| - 1 再算术右移，余数为 x 减去清掉低位的部分
+// 其余的除数：mulh 乘以魔数，商为负时加 1，余数为 x - q * |d|
+// d 为负数时按 |d| 计算，商取反，余数不变
+static void divConst(const string &rd, const string &x, int d, bool mod){
+    if(d == 1 || d == -1){
+        if(mod)
+            rvs.li(rd, 0);
+        else if(d == 1)
+            rvs.mov(x, rd);
+        else
+            rvs.binary("sub", rd, "x0", x);
+        return;
+    }
+    uint32_t ad = d < 0 ? -(uint32_t)d : d;
+    if((ad & (ad - 1)) == 0){
+        int k = __builtin_ctz(ad);
+        if(k == 1){
+            rvs.binary("srli", "t1", x, 31);
+        } else {
+            rvs.binary("srai", "t1", x, 31);
+            rvs.binary("srli", "t1", "t1", 32 - k);
+        }
+        rvs.binary("add", "t1", "t1", x);
+        if(mod){
+            int mask = -(int64_t)ad;
+            if(rvs.immediate(mask)){
+                rvs.binary("andi", "t1", "t1", mask);
+            } else {
+                rvs.li("t2", mask);
+                rvs.binary("and", "t1", "t1", "t2");
+            }
+            rvs.binary("sub", rd, x, "t1");
+        } else if(d > 0){
+            rvs.binary("srai", rd, "t1", k);
+        } else {
+            rvs.binary("srai", "t1", "t1", k);
+            rvs.binary("sub", rd, "x0", "t1");
+        }
+        return;
+    }
+
+    int m, s;
+    divMagic(ad, m, s);
+    rvs.li("t1", m);
+    rvs.binary("mulh", "t1", x, "t1");
+    if(m < 0)
+        rvs.binary("add", "t1", "t1", x);
+    if(s > 0)
+        rvs.binary("srai", "t1", "t1", s);
+    rvs.binary("srli", "t2", x, 31);
+    rvs.binary("add", "t1", "t1", "t2");
+    if(mod){
+        if(!mulConst("t1", "t1", ad)){
+            rvs.li("t2", ad);
+            rvs.binary("mul", "t1", "t1", "t2");
+        }
+        rvs.binary("sub", rd, x, "t1");
+    } else if(d > 0){
+        rvs.mov("t1", rd);
+    } else {
+        rvs.binary("sub", rd, "x0", "t1");
     }
-    if(r->kind.tag == KOOPA_RVT_INTEGER){
-        i = Visit(r->kind.data.integer);
-        rvs.li("t1", i);
-    }else {
-        i = lva.getOffset(r);
-        rvs.load("t1", "sp", i);
+}
+
+// 访问二元运算
+void VisitBinary(IRValue *binary){
+    if(regs.isFolded(binary))
+        return;
+
+    // 乘以、除以常量时用移位和 mulh 代替 mul/div/rem
+    IRValue *a = binary->ops[0], *b = binary->ops[1];
+    if(binary->op == IRValue::OP_MUL && a->tag == IRValue::INTEGER)
+        swap(a, b);
+    bool by_const = b->tag == IRValue::INTEGER && a->tag != IRValue::INTEGER;
+    if(by_const && (binary->op == IRValue::OP_DIV || binary->op == IRValue::OP_MOD) && b->value != 0){
+        string x = getReg(a, "t0");
+        string rd = defReg(binary, "t0");
+        divConst(rd, x, b->value, binary->op == IRValue::OP_MOD);
+        saveDef(binary, rd);
+        return;
     }
+    if(by_const && binary->op == IRValue::OP_MUL){
+        string x = getReg(a, "t0");
+        string rd = defReg(binary, "t0");
+        if(!mulConst(rd, x, b->value)){
+            rvs.li("t1", b->value);
+            rvs.binary("mul", rd, x, "t1");
+        }
+        saveDef(binary, rd);
+        return;
+    }
+
+    // 左右操作数不在寄存器中时加载到t0,t1寄存器
+    string l = getReg(binary->ops[0], "t0");
+    string r = getReg(binary->ops[1], "t1");
+    string rd = defReg(binary, "t0");
     // 判断操作符
-    if(value.op == KOOPA_RBO_NOT_EQ){
-        rvs.binary("xor", "t0" ,"t0", "t1");
-        rvs.two("snez", "t0", "t0");
-    }else if(value.op == KOOPA_RBO_EQ){
-        rvs.binary("xor", "t0" ,"t0", "t1");
-        rvs.two("seqz", "t0", "t0");
-    }else if(value.op == KOOPA_RBO_GE){
-        rvs.binary("slt", "t0", "t0", "t1");
-        rvs.two("seqz", "t0", "t0");
-    }else if(value.op == KOOPA_RBO_LE){
-        rvs.binary("sgt", "t0", "t0", "t1");
-        rvs.two("seqz", "t0", "t0");
+    if(binary->op == IRValue::OP_NOT_EQ){
+        rvs.binary("xor", rd, l, r);
+        rvs.two("snez", rd, rd);
+    }else if(binary->op == IRValue::OP_EQ){
+        rvs.binary("xor", rd, l, r);
+        rvs.two("seqz", rd, rd);
+    }else if(binary->op == IRValue::OP_GE){
+        rvs.binary("slt", rd, l, r);
+        rvs.two("seqz", rd, rd);
+    }else if(binary->op == IRValue::OP_LE){
+        rvs.binary("sgt", rd, l, r);
+        rvs.two("seqz", rd, rd);
     }else{
-        string op = op2inst[(int)value.op];
-        rvs.binary(op, "t0", "t0", "t1");
+        string op = op2inst[(int)binary->op];
+        rvs.binary(op, rd, l, r);
     }
+    saveDef(binary, rd);
+}
 
+// getelemptr/getptr 每个下标的步长
+static size_t stride(IRValue *ptr){
+    IRType *ty = ptr->ops[0]->ty->base;
+    return getTypeSize(ptr->tag == IRValue::GET_ELEM_PTR ? ty->base : ty);
 }
 
-// 访问load指令
-void Visit(const koopa_raw_load_t &load){
-    koopa_raw_value_t src = load.src;
-
-    if(src->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
-        // 全局变量
-        rvs.la("t0", string(src->name + 1));
-        rvs.load("t0", "t0", 0);
-    } else if(src->kind.tag == KOOPA_RVT_ALLOC){
-        // 栈分配
-        int i = lva.getOffset(src);
-        rvs.load("t0", "sp", i);
-    } else{
-        rvs.load("t0", "sp", lva.getOffset(src));
-        rvs.load("t0", "t0", 0);
+// 下标 idx 乘以步长 sz，步长是 2 的幂时用移位，结果在 t2 中（步长为 1 时就是 idx）
+static string scaleIndex(const string &idx, size_t sz){
+    if(sz == 1)
+        return idx;
+    if((sz & (sz - 1)) == 0){
+        rvs.binary("slli", "t2", idx, __builtin_ctzll(sz));
+    } else {
+        rvs.li("t3", sz);
+        rvs.binary("mul", "t2", idx, "t3");
+    }
+    return "t2";
+}
+
+// 指针 v 的地址为 base + offset，返回 base 所在的寄存器
+// alloc 直接相对 sp 寻址，展开的 getelemptr/getptr 在这里计算，中间结果放在 tmp 中
+static string addressOf(IRValue *v, int &offset, const string &tmp){
+    if(v->tag == IRValue::ALLOC){
+        offset = lva.getOffset(v);
+        return "sp";
+    }
+    if(regs.isFolded(v))
+        return elemAddress(v, offset, tmp);
+    offset = 0;
+    return getReg(v, tmp);
+}
+
+// getelemptr/getptr 的地址：常量下标合并到 offset 中，多维数组的下标链一次算完
+string elemAddress(IRValue *v, int &offset, const string &tmp){
+    string base = addressOf(v->ops[0], offset, tmp);
+    IRValue *index = v->ops[1];
+    size_t sz = stride(v);
+    if(index->tag == IRValue::INTEGER){
+        offset += index->value * (int)sz;
+        return base;
     }
+    string idx = scaleIndex(getReg(index, "t2"), sz);
+    rvs.binary("add", tmp, base, idx);
+    return tmp;
+}
+
+// 访问load指令
+void VisitLoad(IRValue *load){
+    string rd = defReg(load, "t0");
+    int offset;
+    string base = addressOf(load->ops[0], offset, "t0");
+    rvs.load(rd, base, offset);
+    saveDef(load, rd);
 }
 
 // 访问store指令
-void Visit(const koopa_raw_store_t &store){
-    koopa_raw_value_t v = store.value, d = store.dest;
-
-    int i, j;
-    if(v->kind.tag == KOOPA_RVT_FUNC_ARG_REF){
-        i = fc.getParamNum(v);
-        if(i < 8){
-            string reg = "a" + to_string(i);
-            if(d->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
-                rvs.la("t0", string(d->name + 1));
-                rvs.store(reg, "t0", 0);
-            }else if(d->kind.tag == KOOPA_RVT_ALLOC){
-                rvs.store(reg,  "sp", lva.getOffset(d));
-            }else{
-                // 间接引用
-                rvs.load("t0", "sp", lva.getOffset(d));
-                rvs.store(reg, "t0", 0);
-            }
-            return;
-        } else{
-            i = (i - 8) * 4;
-            rvs.load("t0", "sp", i + lva.delta);    // caller 栈帧中
-        }
-    }else if(v->kind.tag == KOOPA_RVT_INTEGER){
-        rvs.li("t0", Visit(v->kind.data.integer));
-    } else{
-        i = lva.getOffset(v);
-        rvs.load("t0", "sp", i);
-    }
-    if(d->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
-        rvs.la("t1", string(d->name + 1));
-        rvs.store("t0", "t1", 0);
-    } else if(d->kind.tag == KOOPA_RVT_ALLOC){
-        j = lva.getOffset(d);
-        rvs.store("t0", "sp", j);
-    } else {
-        rvs.load("t1", "sp", lva.getOffset(d));
-        rvs.store("t0","t1", 0);
+void VisitStore(IRValue *store){
+    IRValue *v = store->ops[0], *d = store->ops[1];
+
+    string from = getReg(v, "t0");
+    int offset;
+    string base = addressOf(d, offset, "t1");
+    rvs.store(from, base, offset);
+}
+
+// 跳到 bb 时是否需要给块参数赋值
+static bool needMoves(IRBasicBlock *bb, const vector<IRValue *> &args){
+    for(size_t i = 0; i < args.size(); ++i){
+        IRValue *v = args[i];
+        if(!regs.inReg(v) && (v->tag == IRValue::INTEGER || v->tag == IRValue::GLOBAL_ALLOC || v->tag == IRValue::ALLOC))
+            return true;
+        if(!(locate(bb->params[i]) == locate(v)))
+            return true;
     }
-    
-    return;
+    return false;
 }
 
 // 访问branch指令
-void Visit(const koopa_raw_branch_t &branch){
-    auto true_bb = branch.true_bb;
-    auto false_bb = branch.false_bb;
-    koopa_raw_value_t v = branch.cond;
-    if(v->kind.tag == KOOPA_RVT_INTEGER){
-        rvs.li("t0", Visit(v->kind.data.integer));
-    }else{
-        rvs.load("t0", "sp", lva.getOffset(v));
-    }
-    // 这里，用条件跳转指令跳转范围只有4KB，过不了long_func测试用例
-    // 1MB。
-    // 因此只用bnez实现分支，然后用jump调到目的地。
-    string tmp_label = tlm.getTmpLabel();
-    rvs.bnez("t0", tmp_label);
-    rvs.jump(string(false_bb->name + 1));
-    rvs.label(tmp_label);
-    rvs.jump(string(true_bb->name + 1));
-    return;
+void VisitBranch(IRValue *branch){
+    auto true_bb = branch->target[0];
+    auto false_bb = branch->target[1];
+    IRValue *cond = branch->ops[0];
+    vector<IRValue *> true_args = branch->getArgs(0), false_args = branch->getArgs(1);
+    // 条件跳转直接跳到目标块，超出 ±4KB 的在输出前由分支松弛改成长跳转
+    // 块参数在各自的路径上赋值，只有一边需要赋值时让这一边不跳转
+    // 条件是常量时（没有优化）没有编号，按 bnez 处理
+    BranchMatch m{"bnez", cond, nullptr};
+    if(cond->id >= 0)
+        m = branch_match[branch->id];
+    string op = m.op, l = getReg(m.l, "t0"), r;
+    if(m.r != nullptr)
+        r = getReg(m.r, "t1");
+    bool true_moves = needMoves(true_bb, true_args);
+    bool false_moves = needMoves(false_bb, false_args);
+    if(!true_moves && (false_moves || next_bb != true_bb)){
+        rvs.branch(op, l, r, blockLabel(true_bb));
+        passArgs(false_bb, false_args);
+        if(false_bb != next_bb)
+            rvs.jump(blockLabel(false_bb));
+    } else if(!false_moves){
+        // 条件取反，真分支落到下一条
+        rvs.branch(invertBranch(op), l, r, blockLabel(false_bb));
+        passArgs(true_bb, true_args);
+        if(true_bb != next_bb)
+            rvs.jump(blockLabel(true_bb));
+    } else {
+        string tmp_label = tlm.getTmpLabel();
+        rvs.branch(op, l, r, tmp_label);
+        passArgs(false_bb, false_args);
+        rvs.jump(blockLabel(false_bb));
+        rvs.label(tmp_label);
+        passArgs(true_bb, true_args);
+        rvs.jump(blockLabel(true_bb));
+    }
 }
 
 // 访问jump指令
-void Visit(const koopa_raw_jump_t &jump){
-    auto name = string(jump.target->name + 1);
-    rvs.jump(name);
+void VisitJump(IRValue *jump){
+    string name = blockLabel(jump->target[0]);
+    passArgs(jump->target[0], jump->ops);
+    if(jump->target[0] != next_bb)
+        rvs.jump(name);
     return;
 }
 
+// 跳转前把参数并行地赋给目标块的块参数
+void passArgs(IRBasicBlock *bb, const vector<IRValue *> &args){
+    ParallelMove pm;
+    for(size_t i = 0; i < args.size(); ++i)
+        pm.add(locate(bb->params[i]), args[i]);
+    pm.emit();
+}
+
 // 访问 call 指令
-void Visit(const koopa_raw_call_t &call){
-    for(int i = 0; i < call.args.len; ++i){
-        koopa_raw_value_t v = (koopa_raw_value_t)call.args.buffer[i];
-        if(v->kind.tag == KOOPA_RVT_INTEGER){
-            int j = Visit(v->kind.data.integer);
-            if(i < 8){
-                rvs.li("a" + to_string(i), j);
-            } else {
-                rvs.li("t0", j);
-                rvs.store("t0", "sp", (i - 8) * 4);
-            }
-        } else{
-            int off = lva.getOffset(v);
-            if(i < 8){
-                rvs.load("a" + to_string(i), "sp", off);
-            } else {
-                rvs.load("t0", "sp", off);
-                rvs.store("t0", "sp", (i - 8) * 4);
-            }
+void VisitCall(IRValue *call){
+    // 先存放栈上的参数，再并行地把前8个参数放到 a0 ~ a7
+    // 尾调用的栈上参数放在当前函数收到栈上参数的位置，参数在 prologue 中已经移走了
+    bool tail = tail_call[call->id];
+    int base = tail && frame_active ? lva.delta : 0;
+    for(size_t i = 8; i < call->ops.size(); ++i){
+        rvs.store(getReg(call->ops[i], "t0"), "sp", base + (i - 8) * 4);
+    }
+    ParallelMove pm;
+    for(size_t i = 0; i < call->ops.size() && i < 8; ++i){
+        pm.add(regLoc("a" + to_string(i)), call->ops[i]);
+    }
+    pm.emit();
+    if(tail){
+        epilogue();
+        rvs.tail(symbolName(call->callee->name));
+        return;
+    }
+    rvs.call(symbolName(call->callee->name));
+    if(call->hasResult()){
+        if(regs.inReg(call)){
+            if(string(regs.getReg(call)) != "a0")
+                rvs.mov("a0", regs.getReg(call));
+        } else {
+            rvs.store("a0", "sp", lva.getOffset(call));
         }
     }
-    rvs.call(string(call.callee->name + 1));
-    // if(call.callee->ty->data.function.ret->tag ==KOOPA_RTT_INT32)
-  
     return;
 }
 
 // 访问全局变量
-void VisitGlobalVar(koopa_raw_value_t value){
-    rvs.append("  .data\n");
-    rvs.append("  .globl " + string(value->name + 1) + "\n");
-    rvs.append(string(value->name + 1) + ":\n");
-    koopa_raw_value_t init = value->kind.data.global_alloc.init;
-    auto ty = value->ty->data.pointer.base;
-    if(ty->tag == KOOPA_RTT_INT32){
-        if(init->kind.tag == KOOPA_RVT_ZERO_INIT){
+void VisitGlobalVar(IRValue *value){
+    string_view name = symbolName(value->name);
+    rvs.section(".data", name);
+    IRValue *init = value->ops[0];
+    auto ty = value->ty->base;
+    if(ty->tag == IRType::INT32){
+        if(init->tag == IRValue::ZERO_INIT){
             rvs.zeroInitInt();
         } else {
-            int i = Visit(init->kind.data.integer);
-            rvs.word(i);
+            rvs.word(init->value);
         }
     } else{
         // see aggragate
-        assert (init->kind.tag == KOOPA_RVT_AGGREGATE) ;
         initGlobalArray(init);
     }
     rvs.append("\n");
     return ;
 }
 
-void initGlobalArray(koopa_raw_value_t init){
-    if(init->kind.tag == KOOPA_RVT_INTEGER){
-        int v = Visit(init->kind.data.integer);
-        rvs.word(v);
+void initGlobalArray(IRValue *init){
+    if(init->tag == IRValue::INTEGER){
+        rvs.word(init->value);
+    } else if(init->tag == IRValue::ZERO_INIT){
+        rvs.zeroInit(getTypeSize(init->ty));
     } else {
-        // KOOPA_RVT_AGGREGATE
-        auto elems = init->kind.data.aggregate.elems;
-        for(int i = 0; i < elems.len; ++i){
-            initGlobalArray(reinterpret_cast<koopa_raw_value_t>(elems.buffer[i]));
+        // AGGREGATE
+        for(auto elem : init->ops){
+            initGlobalArray(elem);
         }
     }
 }
 
 // 访问getelemptr指令
-void Visit(const koopa_raw_get_elem_ptr_t& get_elem_ptr){
-    // getelemptr @arr, %2
-        // la t0, arr
-        // li t1 %2
-        // li t2 arr.size
-        // mul t1 t1 t2
-        // add t0 t0 t1
-    koopa_raw_value_t src = get_elem_ptr.src, index = get_elem_ptr.index;
-    size_t sz = getTypeSize(src->ty->data.pointer.base->data.array.base);
-        
-    // 将src的地址放到t0
-    if(src->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
-        rvs.la("t0", string(src->name + 1));
-    }else if(src->kind.tag == KOOPA_RVT_FUNC_ARG_REF){
-        // 我们的KoopaIR保证遇不到
-    } else if(src->kind.tag == KOOPA_RVT_ALLOC){
-        // 栈上就是要找的地址
-        size_t offset = lva.getOffset(src);
-        if(rvs.immediate(offset)){
-            rvs.binary("addi", "t0", "sp", to_string(offset));
-        } else {
-            rvs.li("t0", offset);
-            rvs.binary("add", "t0", "sp", "t0");
-        }
-    } else {
-        // 栈上存的是指针，间接索引
-        rvs.load("t0", "sp", lva.getOffset(src));
-    }
-    // 将index放到t1
-    if(index->kind.tag == KOOPA_RVT_INTEGER){
-        int v = Visit(index->kind.data.integer);
-        rvs.li("t1", v);
-    } else {
-        // 其他情况就是栈上的临时变量
-        rvs.load("t1", "sp", lva.getOffset(index));
-    }
-    // 将size放到t2
-    rvs.li("t2", sz);
-    // 计算真实地址 index * size + base
-    rvs.binary("mul", "t1", "t1", "t2");
-    rvs.binary("add", "t0", "t0", "t1");
+void VisitGetElemPtr(IRValue *get_elem_ptr){
+    // getelemptr @arr, %2 的地址为 @arr + %2 * 元素大小
+    materializeAddress(get_elem_ptr);
 }
 
 // 访问getptr指令
-void Visit(const koopa_raw_get_ptr_t& get_ptr){
-    koopa_raw_value_t src = get_ptr.src, index = get_ptr.index;
-    size_t sz = getTypeSize(src->ty->data.pointer.base);
-
-    // 将src的地址放到t0
-    if(src->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
-        rvs.la("t0", string(src->name + 1));
-    }else if(src->kind.tag == KOOPA_RVT_FUNC_ARG_REF){
-        // 我们的KoopaIR保证遇不到
-    } else if(src->kind.tag == KOOPA_RVT_ALLOC){
-        // 栈上就是要找的地址
-        size_t offset = lva.getOffset(src);
-        if(rvs.immediate(offset)){
-            rvs.binary("addi", "t0", "sp", to_string(offset));
-        } else {
-            rvs.li("t0", offset);
-            rvs.binary("add", "t0", "sp", "t0");
-        }
-    } else {
-        // 栈上存的是指针，间接索引
-        rvs.load("t0", "sp", lva.getOffset(src));
-    }
-    // 将index放到t1
-    if(index->kind.tag == KOOPA_RVT_INTEGER){
-        int v = Visit(index->kind.data.integer);
-        rvs.li("t1", v);
+void VisitGetPtr(IRValue *get_ptr){
+    materializeAddress(get_ptr);
+}
+
+// 把 getelemptr/getptr 的地址算到 value 的位置，在使用处展开的不用计算
+void materializeAddress(IRValue *value){
+    if(regs.isFolded(value))
+        return;
+    int offset;
+    string base = elemAddress(value, offset, "t0");
+    string rd = defReg(value, "t0");
+    if(offset == 0){
+        if(base != rd)
+            rvs.mov(base, rd);
+    } else if(rvs.immediate(offset)){
+        rvs.binary("addi", rd, base, offset);
     } else {
-        // 其他情况就是栈上的临时变量
-        rvs.load("t1", "sp", lva.getOffset(index));
+        rvs.li("t3", offset);
+        rvs.binary("add", rd, base, "t3");
     }
-    // 将size放到t2
-    rvs.li("t2", sz);
-    // 计算真实地址 index * size + base
-    rvs.binary("mul", "t1", "t1", "t2");
-    rvs.binary("add", "t0", "t0", "t1");
+    saveDef(value, rd);
 }
 
-// 函数 局部变量分配栈地址
-void allocLocal(const koopa_raw_function_t &func){
-    for(size_t i = 0; i < func->bbs.len; ++i){
-        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
-        for(int j = 0; j < bb->insts.len; ++j){
-            auto value = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+// 函数 局部变量和溢出的值分配栈地址
+// 溢出的值放在前面，访问频繁，偏移量小，不容易超出 12 位立即数的范围
+void allocLocal(IRFunction *func){
+    lva.allocSpills(regs.spills);
+    for(auto bb : func->bbs){
+        for(auto value : bb->insts){
 
             // 下面开始处理一条指令
 
             // 特判alloc
-            if(value->kind.tag == KOOPA_RVT_ALLOC ){
-                int sz = getTypeSize(value->ty->data.pointer.base);
+            if(value->tag == IRValue::ALLOC){
+                int sz = getTypeSize(value->ty->base);
                 lva.alloc(value, sz);
                 continue;
             }
-            if(value->kind.tag == KOOPA_RVT_CALL){
-                koopa_raw_call_t c = value->kind.data.call;
+            if(value->tag == IRValue::CALL && !tail_call[value->id]){
                 lva.setR();                 // 保存恢复ra
-                lva.setA((size_t)max(0, ((int)c.args.len - 8 ) * 4));    // 超过8个参数
-            }
-            size_t sz = getTypeSize(value->ty);
-            if(sz){
-                lva.alloc(value, sz);
+                lva.setA((size_t)max(0, ((int)value->ops.size() - 8 ) * 4));    // 超过8个参数
             }
         }
     }
 }   
 
-// 计算类型koopa_raw_type_t的大小
-size_t getTypeSize(koopa_raw_type_t ty){
+// 计算类型IRType的大小
+size_t getTypeSize(IRType *ty){
     switch(ty->tag){
-        case KOOPA_RTT_INT32:
+        case IRType::INT32:
             return 4;
-        case KOOPA_RTT_UNIT:
+        case IRType::UNIT:
             return 0;
-        case KOOPA_RTT_ARRAY:
-            return ty->data.array.len * getTypeSize(ty->data.array.base);
-        case KOOPA_RTT_POINTER:
+        case IRType::ARRAY:
+            return ty->len * getTypeSize(ty->base);
+        case IRType::POINTER:
             return 4;
-        case KOOPA_RTT_FUNCTION:
+        case IRType::FUNCTION:
             return 0;
     }
     return 0;
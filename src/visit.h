@@ -1,103 +1,193 @@
 #pragma once
-#include "koopa.h"
+#include "IR.h"
 #include "Symbol.h"
+#include "Emitter.h"
+#include "Peephole.h"
 
 class RiscvString{
 private:
-    std::string riscv_str;
+    Emitter out;
+    std::vector<RiscvInst> insts;
+    int relax_cnt = 0;      // 分支松弛新建的标号数
     /**
-     * 默认只用t0 t1 t2
-     * t3 t4 t5作为备用，临时的，随时可能被修改，不安全
+     * 汇编先记在 insts 中，一个函数结束后做窥孔优化，再写入 out 的缓冲区
+     * 缓冲区满了整块写到输出文件，内存中最多保留一个函数的汇编
+     * t0 t1 t2 作为临时寄存器，t3 用于偏移量超出立即数范围时计算地址
+     * 其余的 t/a/s 寄存器由 RegisterAllocator 分配
     */
+
+    // 助记符补齐到 6 个字符
+    void inst(std::string_view op){
+        out << "  " << op;
+        out.pad(op.length() < 6 ? 6 - op.length() : 1);
+    }
+    RiscvInst &push(RiscvInst::KIND kind){
+        insts.emplace_back(kind);
+        return insts.back();
+    }
+    void print(const RiscvInst &v){
+        switch(v.kind){
+            case RiscvInst::LABEL: out << v.sym << ":\n"; break;
+            case RiscvInst::TEXT: out << v.sym; break;
+            case RiscvInst::RR: inst(v.op); out << v.rd << ", " << v.rs1 << ", " << v.rs2 << '\n'; break;
+            case RiscvInst::RI: inst(v.op); out << v.rd << ", " << v.rs1 << ", " << v.imm << '\n'; break;
+            case RiscvInst::R: inst(v.op); out << v.rd << ", " << v.rs1 << '\n'; break;
+            case RiscvInst::MV: out << "  mv    " << v.rd << ", " << v.rs1 << '\n'; break;
+            case RiscvInst::LI: out << "  li    " << v.rd << ", " << v.imm << '\n'; break;
+            case RiscvInst::LA: out << "  la    " << v.rd << ", " << v.sym << '\n'; break;
+            case RiscvInst::LW: out << "  lw    " << v.rd << ", " << v.imm << '(' << v.rs1 << ")\n"; break;
+            case RiscvInst::SW: out << "  sw    " << v.rs2 << ", " << v.imm << '(' << v.rs1 << ")\n"; break;
+            case RiscvInst::BZ: inst(v.op); out << v.rs1 << ", " << v.sym << '\n'; break;
+            case RiscvInst::BR: inst(v.op); out << v.rs1 << ", " << v.rs2 << ", " << v.sym << '\n'; break;
+            case RiscvInst::J: out << "  j     " << v.sym << '\n'; break;
+            case RiscvInst::CALL: out << "  call " << v.sym << '\n'; break;
+            case RiscvInst::TAIL: out << "  tail " << v.sym << '\n'; break;
+            case RiscvInst::RET: out << "  ret\n"; break;
+        }
+    }
 public:
+    Peephole peephole;
+    bool optimize = true;   // 是否做窥孔优化
+    int relaxed = 0;        // 超出范围改成长跳转的分支数
+
+    void open(std::ostream &os){ out.open(os); }
+    // 输出记下的汇编，函数结束时调用
+    void endFunction(){
+        if(optimize)
+            peephole.run(insts);
+        relaxed += relaxBranches(insts, "Relax", relax_cnt);
+        for(auto &v : insts)
+            print(v);
+        insts.clear();
+    }
+    void flush(){
+        endFunction();
+        out.flush();
+    }
+
     bool immediate(int i){ return -2048 <= i && i < 2048; }
 
-    void binary(const std::string &op, const std::string &rd, const std::string &rs1, const std::string &rs2){
-    riscv_str += "  " + op + std::string(6-op.length(),' ') + rd + ", " + rs1 + ", " + rs2 + "\n";
+    void binary(std::string_view op, std::string_view rd, std::string_view rs1, std::string_view rs2){
+        RiscvInst &v = push(RiscvInst::RR);
+        v.op = op; v.rd = rd; v.rs1 = rs1; v.rs2 = rs2;
+    }
+
+    // addi/slti/xori 等带立即数的指令
+    void binary(std::string_view op, std::string_view rd, std::string_view rs1, int imm){
+        RiscvInst &v = push(RiscvInst::RI);
+        v.op = op; v.rd = rd; v.rs1 = rs1; v.imm = imm;
     }
     
-    void two(const std::string &op, const std::string &a, const std::string &b){
-        riscv_str += "  " + op + std::string(6 - op.length(), ' ') + a + ", " + b + "\n";
+    // seqz/snez 等
+    void two(std::string_view op, std::string_view rd, std::string_view rs){
+        RiscvInst &v = push(RiscvInst::R);
+        v.op = op; v.rd = rd; v.rs1 = rs;
     }
 
-    void append(const std::string &s){
-        riscv_str += s;
+    void append(std::string_view s){
+        push(RiscvInst::TEXT).sym = s;
     }
 
-    void mov(const std::string &from, const std::string &to){
-        riscv_str += "  mv    " + to + ", "  + from + '\n';
+    void mov(std::string_view from, std::string_view to){
+        RiscvInst &v = push(RiscvInst::MV);
+        v.rd = to; v.rs1 = from;
     }
 
     void ret(){
-        riscv_str += "  ret\n";
+        push(RiscvInst::RET);
     }
 
-    void li(const std::string &to, int im){
-        riscv_str += "  li    " + to + ", " + std::to_string(im) + "\n";
+    void li(std::string_view to, int im){
+        RiscvInst &v = push(RiscvInst::LI);
+        v.rd = to; v.imm = im;
     }
 
-    void load(const std::string &to, const std::string &base ,int offset){
-        if(offset >= -2048 && offset < 2048)
-            riscv_str += "  lw    " + to + ", " + std::to_string(offset) + "(" + base + ")\n";    
-        else{
+    void load(std::string_view to, std::string_view base, int offset){
+        if(!immediate(offset)){
             this->li("t3", offset);
             this->binary("add", "t3", "t3", base);
-            riscv_str += "  lw    " + to + ", " + "0" + "(" + "t3" + ")\n";    
+            base = "t3";
+            offset = 0;
         }
+        RiscvInst &v = push(RiscvInst::LW);
+        v.rd = to; v.rs1 = base; v.imm = offset;
     }
 
 
-    void store(const std::string &from, const std::string &base ,int offset){
-        if(offset >= -2048 && offset < 2048)
-            riscv_str += "  sw    " + from + ", " + std::to_string(offset) + "(" + base + ")\n";    
-        else{
+    void store(std::string_view from, std::string_view base, int offset){
+        if(!immediate(offset)){
             this->li("t3", offset);
             this->binary("add", "t3", "t3", base);
-            riscv_str += "  sw    " + from + ", " + "0" + "(" + "t3" + ")\n";  
+            base = "t3";
+            offset = 0;
         }
+        RiscvInst &v = push(RiscvInst::SW);
+        v.rs2 = from; v.rs1 = base; v.imm = offset;
     }
 
     void sp(int delta){
-        if(delta >= -2048 && delta < 2048){
-            this->binary("addi", "sp", "sp", std::to_string(delta));
+        if(immediate(delta)){
+            this->binary("addi", "sp", "sp", delta);
         }else{
             this->li("t0", delta);
             this->binary("add", "sp", "sp", "t0");
         }
     }
     
-    void label(const std::string &name){
-        this->append(name + ":\n");
+    void label(std::string_view name){
+        push(RiscvInst::LABEL).sym = name;
+    }
+
+    void bnez(std::string_view rs, std::string_view target){
+        RiscvInst &v = push(RiscvInst::BZ);
+        v.op = "bnez"; v.rs1 = rs; v.sym = target;
+    }
+
+    // beq/bne/blt/bgt/ble/bge，rs2 为空时是 bnez/beqz
+    void branch(std::string_view op, std::string_view rs1, std::string_view rs2, std::string_view target){
+        RiscvInst &v = push(rs2.empty() ? RiscvInst::BZ : RiscvInst::BR);
+        v.op = op; v.rs1 = rs1; v.rs2 = rs2; v.sym = target;
     }
 
-    void bnez(const std::string &rs, const std::string &target){
-        this->two("bnez", rs, target);
+    void jump(std::string_view target){
+        push(RiscvInst::J).sym = target;
     }
 
-    void jump(const std::string &target){
-        this->append("  j     " + target + "\n");
+    void call(std::string_view func){
+        push(RiscvInst::CALL).sym = func;
     }
 
-    void call(const std::string &func){
-        this->append("  call " + func + "\n");
+    void tail(std::string_view func){
+        push(RiscvInst::TAIL).sym = func;
     }
 
     void zeroInitInt(){
         this->append("  .zero 4\n");
     }
 
+    void zeroInit(size_t size){
+        this->append("  .zero " + std::to_string(size) + "\n");
+    }
+
     void word(int i){
         this->append("  .word " + std::to_string(i) + "\n");
     }
 
-    void la(const std::string &to, const std::string &name){
-        this->append("  la    " + to + ", " + name + "\n");
+    void la(std::string_view to, std::string_view name){
+        RiscvInst &v = push(RiscvInst::LA);
+        v.rd = to; v.sym = name;
     }
 
-    const char* c_str(){
-        return riscv_str.c_str();
+    // .text/.data 段中的全局符号
+    void section(std::string_view sec, std::string_view name){
+        std::string s = "  ";
+        s += sec;
+        s += "\n  .globl ";
+        s += name;
+        s += '\n';
+        this->append(s);
+        this->label(name);
     }
-
 };
 
 // 后端riscv生成时，使用到的临时标号
@@ -112,27 +202,30 @@ public:
 };
 
 // 函数声明
-void Visit(const koopa_raw_program_t &program);
-void Visit(const koopa_raw_slice_t &slice) ;
-void Visit(const koopa_raw_function_t &func);
-void Visit(const koopa_raw_basic_block_t &bb);
-void Visit(const koopa_raw_value_t &value);
-
-void Visit(const koopa_raw_return_t &value);
-int Visit(const koopa_raw_integer_t &value);
-void Visit(const koopa_raw_binary_t &value);
-void Visit(const koopa_raw_load_t &load);
-void Visit(const koopa_raw_store_t &store);
-void Visit(const koopa_raw_branch_t &branch);
-void Visit(const koopa_raw_jump_t &jump);
-void Visit(const koopa_raw_call_t &call);
-void Visit(const koopa_raw_get_elem_ptr_t& get_elem_ptr);
-void Visit(const koopa_raw_get_ptr_t& get_ptr);
-
-
-void VisitGlobalVar(koopa_raw_value_t value);
-void initGlobalArray(koopa_raw_value_t init);
-
-void allocLocal(const koopa_raw_function_t &func);
-
-size_t getTypeSize(koopa_raw_type_t ty);
\ No newline at end of file
+void Visit(const IRProgram &program);
+void Visit(IRFunction *func);
+void Visit(IRBasicBlock *bb);
+void Visit(IRValue *value);
+
+void VisitReturn(IRValue *ret);
+void prologue();
+void epilogue();
+void VisitBinary(IRValue *binary);
+void VisitLoad(IRValue *load);
+void VisitStore(IRValue *store);
+void VisitBranch(IRValue *branch);
+void VisitJump(IRValue *jump);
+void passArgs(IRBasicBlock *bb, const std::vector<IRValue *> &args);
+void VisitCall(IRValue *call);
+void VisitGetElemPtr(IRValue *get_elem_ptr);
+void VisitGetPtr(IRValue *get_ptr);
+void materializeAddress(IRValue *value);
+std::string elemAddress(IRValue *v, int &offset, const std::string &tmp);
+
+
+void VisitGlobalVar(IRValue *value);
+void initGlobalArray(IRValue *init);
+
+void allocLocal(IRFunction *func);
+
+size_t getTypeSize(IRType *ty);
\ No newline at end of file
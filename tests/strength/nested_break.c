@@ -0,0 +1,20 @@
+// 内层循环 break 的 br 块同时是内层和外层循环的回边，插入的两个块不能重名
+int main(){
+    int n = getint();
+    int m = getint();
+    int k = getint();
+    int i = 0;
+    while(i < n){
+        putint(i * 7);
+        i = i + 1;
+        int j = 0;
+        while(j < m){
+            putint(j * 5);
+            j = j + 1;
+            if(j == k)
+                break;
+        }
+    }
+    putch(10);
+    return 0;
+}
@@ -0,0 +1,59 @@
+// 尾递归改成循环之后，原来的入口块的标号不能和函数 f_tail 重复
+int f_tail(int n, int acc){
+    int s = 0;
+    while(n > 0){
+        s = s + acc * 1 - n % 3;
+        putch(48 + s % 10);
+        s = s + acc * 2 - n % 4;
+        putch(48 + s % 10);
+        s = s + acc * 3 - n % 5;
+        putch(48 + s % 10);
+        s = s + acc * 4 - n % 6;
+        putch(48 + s % 10);
+        s = s + acc * 5 - n % 7;
+        putch(48 + s % 10);
+        s = s + acc * 6 - n % 8;
+        putch(48 + s % 10);
+        s = s + acc * 7 - n % 9;
+        putch(48 + s % 10);
+        s = s + acc * 8 - n % 10;
+        putch(48 + s % 10);
+        n = n - 1;
+    }
+    putch(10);
+    return s;
+}
+
+int f(int n, int acc){
+    if(n == 0)
+        return acc;
+    acc = acc + n * 1 - n / 2;
+    putint(acc % 8);
+    acc = acc + n * 2 - n / 3;
+    putint(acc % 9);
+    acc = acc + n * 3 - n / 4;
+    putint(acc % 10);
+    acc = acc + n * 4 - n / 5;
+    putint(acc % 11);
+    acc = acc + n * 5 - n / 6;
+    putint(acc % 12);
+    acc = acc + n * 6 - n / 7;
+    putint(acc % 13);
+    acc = acc + n * 7 - n / 8;
+    putint(acc % 14);
+    acc = acc + n * 8 - n / 9;
+    putint(acc % 15);
+    putch(10);
+    return f(n - 1, acc);
+}
+
+int main(){
+    int n = getint();
+    int a = f(n, 0) + f(n - 1, 1);
+    int b = f_tail(n, 2) + f_tail(n + 1, 3);
+    putint(a);
+    putch(10);
+    putint(b);
+    putch(10);
+    return 0;
+}
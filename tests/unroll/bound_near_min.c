@@ -0,0 +1,12 @@
+// n 离 INT_MIN 不到 (U - 1) * step，n - (U - 1) * step 会溢出，只能执行余数循环
+int main(){
+    int n = getint();
+    int s = 0;
+    int i = n - 2;
+    while(i < n){
+        s = s + 1;
+        i = i + 1;
+    }
+    putint(s);
+    return 0;
+}
@@ -0,0 +1,15 @@
+// 第一个循环完全展开之后，它的出口是第二个循环在循环外唯一的前驱
+int main(){
+    int s = 0;
+    int i = 0;
+    while(i < 3){
+        s = s + i;
+        i = i + 1;
+    }
+    int j = 0;
+    while(j < 2){
+        s = s * 2 + j;
+        j = j + 1;
+    }
+    return s;
+}